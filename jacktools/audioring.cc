@@ -0,0 +1,107 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#include <string.h>
+#include "audioring.h"
+
+
+Audioring::Audioring (int nchan, int size) :
+    _nchan (nchan),
+    _size (1),
+    _wr (0),
+    _rd (0),
+    _drop (0)
+{
+    while (_size < size) _size *= 2;
+    _buf = new float [_nchan * _size];
+    memset (_buf, 0, _nchan * _size * sizeof (float));
+}
+
+
+Audioring::~Audioring (void)
+{
+    delete[] _buf;
+}
+
+
+bool Audioring::write (float * const *p, int n)
+{
+    // Called by JACK's process callback. Costs one memcpy per channel,
+    // in two parts where the ring wraps.
+
+    const unsigned int wr = _wr;
+    const int          i = wr & (_size - 1);
+    const int          k = (n < _size - i) ? n : _size - i;
+
+    if (n > _size - (int)(wr - __atomic_load_n (&_rd, __ATOMIC_ACQUIRE)))
+    {
+        __atomic_store_n (&_drop, _drop + n, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    for (int c = 0; c < _nchan; c++)
+    {
+        float *d = _buf + c * _size;
+
+        if (p [c])
+        {
+            memcpy (d + i, p [c], k * sizeof (float));
+            memcpy (d, p [c] + k, (n - k) * sizeof (float));
+        }
+        else
+        {
+            memset (d + i, 0, k * sizeof (float));
+            memset (d, 0, (n - k) * sizeof (float));
+        }
+    }
+    __atomic_store_n (&_wr, wr + n, __ATOMIC_RELEASE);
+    return true;
+}
+
+
+int Audioring::avail (void) const
+{
+    return (int)(__atomic_load_n (&_wr, __ATOMIC_ACQUIRE) - _rd);
+}
+
+
+int Audioring::read (float * const *p, int n)
+{
+    // Copies up to n frames of every channel, returns the number copied.
+
+    const unsigned int rd = _rd;
+    const int          i = rd & (_size - 1);
+    const int          a = avail ();
+    int                k;
+
+    if (n > a) n = a;
+    k = (n < _size - i) ? n : _size - i;
+
+    for (int c = 0; c < _nchan; c++)
+    {
+        const float *s = _buf + c * _size;
+
+        memcpy (p [c], s + i, k * sizeof (float));
+        memcpy (p [c] + k, s, (n - k) * sizeof (float));
+    }
+    __atomic_store_n (&_rd, rd + n, __ATOMIC_RELEASE);
+    return n;
+}
@@ -0,0 +1,60 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#ifndef __AUDIORING_H
+#define __AUDIORING_H
+
+
+// Multichannel audio ring from the process callback to one reader
+// thread. Wait-free on both sides, all memory is allocated up front.
+// Channels share the write and read positions, so they stay in step.
+// A period that does not fit is dropped whole and counted, the writer
+// never waits for the reader.
+
+class Audioring
+{
+public:
+
+    Audioring (int nchan, int size);
+    ~Audioring (void);
+
+    int nchan (void) const { return _nchan; }
+
+    // writer side, a null pointer writes zeros
+    bool write (float * const *p, int n);
+
+    // reader side
+    int avail (void) const;
+    int read (float * const *p, int n);
+    unsigned int dropped (void) const { return __atomic_load_n (&_drop, __ATOMIC_RELAXED); }
+
+private:
+
+    int              _nchan;
+    int              _size;    // frames, a power of 2
+    float           *_buf;     // _nchan rows of _size frames
+    unsigned int     _wr;      // frames written, only written by the writer
+    unsigned int     _rd;      // frames read, only written by the reader
+    unsigned int     _drop;    // frames dropped for lack of space
+};
+
+
+#endif
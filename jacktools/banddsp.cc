@@ -0,0 +1,135 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#include <math.h>
+#include <string.h>
+#include "banddsp.h"
+
+
+Banddsp::Banddsp (void) :
+    _nband (0),
+    _wms (0)
+{
+    init (48000);
+}
+
+
+Banddsp::~Banddsp (void)
+{
+}
+
+
+float Banddsp::center (int band)
+{
+    // Nominal centre frequency, octaves around 1 kHz.
+
+    return 1000.0f * exp2f ((float)(band - 5));
+}
+
+
+void Banddsp::init (int fsamp)
+{
+    // Called by initialisation code, not while processing.
+    //
+    // fsamp = sample frequency
+    //
+    // Two identical stages of Q = 0.91 are 3 dB down one half octave
+    // each side of the centre. Bands whose centre is above 0.4 fsamp
+    // are left out.
+
+    const float q = 0.91f;
+    float       w, a, d;
+
+    for (_nband = 0; _nband < NBAND; _nband++)
+    {
+        if (center (_nband) > 0.4f * fsamp) break;
+        w = 2 * (float) M_PI * center (_nband) / fsamp;
+        a = sinf (w) / (2 * q);
+        d = 1 + a;
+        _b0 [_nband] = a / d;
+        _a1 [_nband] = -2 * cosf (w) / d;
+        _a2 [_nband] = (1 - a) / d;
+    }
+    _wms = 1.0f / (0.3f * fsamp);
+    reset ();
+}
+
+
+void Banddsp::reset (void)
+{
+    memset (_z, 0, sizeof (_z));
+    memset (_ms, 0, sizeof (_ms));
+    memset (_lev, 0, sizeof (_lev));
+}
+
+
+void Banddsp::process (const float * const *p, int nchan, int n)
+{
+    // Called by the worker thread.
+    //
+    // p     : pointers to the sample buffers of all channels
+    // nchan : number of channels, at most MAXCHAN
+    // n     : number of samples to process
+
+    float  b0, a1, a2, x, y, ms;
+    float  z0, z1, z2, z3;
+
+    for (int c = 0; c < nchan; c++)
+    {
+        const float *q = p [c];
+
+        for (int b = 0; b < _nband; b++)
+        {
+            float *z = _z [c][b];
+
+            b0 = _b0 [b];
+            a1 = _a1 [b];
+            a2 = _a2 [b];
+            z0 = z [0];
+            z1 = z [1];
+            z2 = z [2];
+            z3 = z [3];
+            ms = _ms [c][b];
+            for (int j = 0; j < n; j++)
+            {
+                // Transposed direct form II, b1 = 0 and b2 = -b0.
+                x = q [j];
+                y = b0 * x + z0;
+                z0 = z1 - a1 * y;
+                z1 = -b0 * x - a2 * y;
+                x = y;
+                y = b0 * x + z2;
+                z2 = z3 - a1 * y;
+                z3 = -b0 * x - a2 * y;
+                ms += _wms * (y * y - ms);
+            }
+            // Flush to zero before anything turns denormal.
+            if (fabsf (z0) + fabsf (z1) + fabsf (z2) + fabsf (z3) < 1e-20f) z0 = z1 = z2 = z3 = 0;
+            if (ms < 1e-20f) ms = 0;
+            z [0] = z0;
+            z [1] = z1;
+            z [2] = z2;
+            z [3] = z3;
+            _ms [c][b] = ms;
+            _lev [c][b] = sqrtf (2 * ms);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#ifndef __BANDDSP_H
+#define __BANDDSP_H
+
+
+// Octave band levels, 31.5 Hz to 16 kHz. Each band is two cascaded
+// band pass biquads, together 1 octave wide at -3 dB, followed by a
+// mean square average over 0.3 s. Too heavy for the process callback,
+// it is meant to run on a worker thread fed by an Audioring.
+
+class Banddsp
+{
+public:
+
+    enum { MAXCHAN = 8, NBAND = 10 };
+
+    Banddsp (void);
+    ~Banddsp (void);
+
+    void init (int fsamp);
+    void reset (void);
+    void process (const float * const *p, int nchan, int n);
+
+    // Level of a band, scaled so that a full scale sine at the centre
+    // reads 1. Bands above 0.4 fsamp read 0.
+    float read (int chan, int band) const { return _lev [chan][band]; }
+
+    static float center (int band);
+
+private:
+
+    int            _nband;             // bands below Nyquist
+    float          _b0 [NBAND];        // band pass, b1 = 0 and b2 = -b0
+    float          _a1 [NBAND];
+    float          _a2 [NBAND];
+    float          _wms;               // averaging coefficient
+    float          _z [MAXCHAN][NBAND][4];
+    float          _ms [MAXCHAN][NBAND];
+    float          _lev [MAXCHAN][NBAND];
+};
+
+
+#endif
@@ -0,0 +1,80 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#ifndef __COEFFBOX_H
+#define __COEFFBOX_H
+
+
+#include <sched.h>
+
+
+// Hands a block of coefficients from setup code to the process
+// callback, which never waits. A triple buffer: the writer fills a
+// spare slot and swaps it in, the process side swaps out the newest
+// slot when one is there.
+//
+// Writers may be on any non-RT threads, they are serialised by a spin
+// lock. The writer copy is kept, so a writer can change a few fields
+// and recompute the rest.
+
+template <class T> class Coeffbox
+{
+public:
+
+    Coeffbox (void) : _wr (0), _rd (1), _mid (2), _lock (0) {}
+
+    // writer side, edit the returned copy, then commit()
+    T *edit (void)
+    {
+        while (__atomic_exchange_n (&_lock, 1, __ATOMIC_ACQUIRE)) sched_yield ();
+        return &_copy;
+    }
+
+    void commit (void)
+    {
+        _slots [_wr] = _copy;
+        _wr = __atomic_exchange_n (&_mid, _wr | FRESH, __ATOMIC_ACQ_REL) & INDEX;
+        __atomic_store_n (&_lock, 0, __ATOMIC_RELEASE);
+    }
+
+    // process side, the newest block or NULL if nothing changed
+    // since the previous call
+    const T *fetch (void)
+    {
+        if (!(__atomic_load_n (&_mid, __ATOMIC_RELAXED) & FRESH)) return 0;
+        _rd = __atomic_exchange_n (&_mid, _rd, __ATOMIC_ACQ_REL) & INDEX;
+        return _slots + _rd;
+    }
+
+private:
+
+    enum { FRESH = 4, INDEX = 3 };
+
+    T     _slots [3];
+    T     _copy;
+    int   _wr;      // slot owned by writers
+    int   _rd;      // slot owned by the process side
+    int   _mid;     // shared slot index, plus FRESH flag
+    int   _lock;
+};
+
+
+#endif
@@ -0,0 +1,165 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2008-2015 Fons Adriaensen <fons@linuxaudio.org>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#include <math.h>
+#include <string.h>
+#include "corrdsp.h"
+
+
+Corrdsp::Corrdsp (void) :
+    _w1 (0),
+    _w2 (0)
+{
+    init (48000);
+    reset ();
+}
+
+
+Corrdsp::~Corrdsp (void)
+{
+}
+
+
+void Corrdsp::init (int fsamp)
+{
+    // Called by initialisation code, and on sample rate changes.
+    //
+    // fsamp = sample frequency
+
+    Coeffs *C = _coef.edit ();
+    C->w1 = 6.28f * 2000.0f / fsamp;         // low pass coefficient
+    C->w2 = 1.0f / (0.3f * fsamp);           // averaging coefficient
+    _coef.commit ();
+}
+
+
+void Corrdsp::reset (void)
+{
+    memset (_zl, 0, sizeof (_zl));
+    memset (_zr, 0, sizeof (_zr));
+    memset (_zlr, 0, sizeof (_zlr));
+    memset (_zll, 0, sizeof (_zll));
+    memset (_zrr, 0, sizeof (_zrr));
+    memset (_corr, 0, sizeof (_corr));
+    memset (_bal, 0, sizeof (_bal));
+}
+
+
+void Corrdsp::update (void)
+{
+    const Coeffs *C = _coef.fetch ();
+
+    if (!C) return;
+    _w1 = C->w1;
+    _w2 = C->w2;
+}
+
+
+void Corrdsp::process (float * const *p, int npair, int n)
+{
+    // Called by JACK's process callback.
+    //
+    // p     : pointers to the sample buffers, left and right of pair k
+    //         at 2 * k and 2 * k + 1. A null pointer clears the pair.
+    // npair : number of pairs, at most MAXPAIR
+    // n     : number of samples to process
+
+    int  pair [MAXPAIR];
+    int  i, k;
+
+    update ();
+
+    for (i = k = 0; i < npair; i++)
+    {
+        if (p [2 * i] && p [2 * i + 1]) pair [k++] = i;
+        else _zl [i] = _zr [i] = _zlr [i] = _zll [i] = _zrr [i] = 0;
+    }
+
+    for (i = 0; i < k; i += VECLEN)
+    {
+        process_group (p, pair + i, (k - i < VECLEN) ? k - i : VECLEN, n);
+    }
+
+    // Both are ratios, they would keep their value while the signal
+    // decays, so they drop to zero below -100 dB.
+    for (i = 0; i < npair; i++)
+    {
+        if (_zll [i] + _zrr [i] < CORRDSP_FLOOR) _corr [i] = _bal [i] = 0;
+        else
+        {
+            _corr [i] = _zlr [i] / sqrtf (_zll [i] * _zrr [i] + 1e-30f);
+            _bal [i] = (_zrr [i] - _zll [i]) / (_zrr [i] + _zll [i]);
+        }
+    }
+}
+
+
+void Corrdsp::process_group (float * const *p, const int *pair, int npair, int n)
+{
+    // Processes up to VECLEN pairs, one pair per vector lane. Unused
+    // lanes repeat the first pair and their results are ignored.
+
+    const float  *ql [VECLEN];
+    const float  *qr [VECLEN];
+    vec_t         zl, zr, zlr, zll, zrr;
+    int           c [VECLEN];
+    int           i, j;
+
+    for (i = 0; i < VECLEN; i++)
+    {
+        c [i] = pair [(i < npair) ? i : 0];
+        ql [i] = p [2 * c [i]];
+        qr [i] = p [2 * c [i] + 1];
+        zl [i] = _zl [c [i]];
+        zr [i] = _zr [c [i]];
+        zlr [i] = _zlr [c [i]];
+        zll [i] = _zll [c [i]];
+        zrr [i] = _zrr [c [i]];
+    }
+
+    for (j = 0; j < n; j++)
+    {
+        vec_t l = {}, r = {};
+        for (i = 0; i < VECLEN; i++)
+        {
+            l [i] = ql [i][j];
+            r [i] = qr [i][j];
+        }
+
+        // The tiny offset keeps the squares clear of denormals in
+        // silence.
+        zl += _w1 * (l - zl) + 1e-15f;
+        zr += _w1 * (r - zr) + 1e-15f;
+        zlr += _w2 * (zl * zr - zlr);
+        zll += _w2 * (zl * zl - zll);
+        zrr += _w2 * (zr * zr - zrr);
+    }
+
+    for (i = 0; i < npair; i++)
+    {
+        _zl [c [i]] = zl [i];
+        _zr [c [i]] = zr [i];
+        _zlr [c [i]] = zlr [i];
+        _zll [c [i]] = zll [i];
+        _zrr [c [i]] = zrr [i];
+    }
+}
@@ -0,0 +1,95 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2008-2015 Fons Adriaensen <fons@linuxaudio.org>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#ifndef __CORRDSP_H
+#define __CORRDSP_H
+
+
+#include "coeffbox.h"
+
+
+// Number of pairs processed together, as for Kmeterdsp.
+
+#if defined(__AVX__)
+#define CORRDSP_VECLEN 8
+#else
+#define CORRDSP_VECLEN 4
+#endif
+
+
+// Mean square level below which both read zero.
+
+#define CORRDSP_FLOOR 1e-10f
+
+
+// Stereo correlation and balance of channel pairs. Both signals are
+// low-passed (2 kHz) so the highest frequencies do not dominate, their
+// products and squares are averaged over 0.3 s. Correlation runs from
+// -1 (out of phase) to +1 (mono), balance from -1 (left only) to +1
+// (right only).
+
+class Corrdsp
+{
+public:
+
+    enum { VECLEN = CORRDSP_VECLEN, MAXPAIR = 32 };
+
+    Corrdsp (void);
+    ~Corrdsp (void);
+
+    // Sample rate, from any non-RT thread while processing.
+    void init (int fsamp);
+    void reset (void);
+    void process (float * const *p, int npair, int n);
+
+    float correlation (int pair) const { return _corr [pair]; }
+    float balance (int pair) const { return _bal [pair]; }
+
+private:
+
+    typedef float vec_t __attribute__ ((vector_size (VECLEN * sizeof (float))));
+
+    struct Coeffs
+    {
+        float  w1;
+        float  w2;
+    };
+
+    void update (void);
+    void process_group (float * const *p, const int *pair, int npair, int n);
+
+    Coeffbox<Coeffs> _coef;
+    float          _w1;                // low pass coefficient
+    float          _w2;                // averaging coefficient
+
+    // Filter state per pair, one array per variable.
+    float          _zl [MAXPAIR];
+    float          _zr [MAXPAIR];
+    float          _zlr [MAXPAIR];
+    float          _zll [MAXPAIR];
+    float          _zrr [MAXPAIR];
+    float          _corr [MAXPAIR];
+    float          _bal [MAXPAIR];
+};
+
+
+#endif
@@ -88,19 +88,8 @@ int Jclient::open_jack (int max_inps, int max_outs)
 {
     struct sched_param sched_par;
 
-    jack_set_thread_init_callback (_client, jack_static_thread_init, NULL);
-    jack_set_buffer_size_callback (_client, jack_static_bufsize, (void *) this);
-    jack_set_process_callback (_client, jack_static_process, (void *) this);
-    jack_on_shutdown (_client, jack_static_shutdown, (void *) this);
-    jack_activate (_client);
-
-    _jack_name = jack_get_client_name (_client);
-    _jack_rate = jack_get_sample_rate (_client);
-    _jack_size = jack_get_buffer_size (_client);
-
-    pthread_getschedparam (jack_client_thread_id (_client), &_schedpol, &sched_par);
-    _priority = sched_par.sched_priority;
-
+    // The port tables are used by the connection callbacks, which can
+    // run as soon as they are set.
     _max_inps = max_inps;
     if (max_inps)
     {
@@ -114,6 +103,22 @@ int Jclient::open_jack (int max_inps, int max_outs)
         memset (_out_ports, 0, max_outs * sizeof (jack_port_t *));
     }
 
+    jack_set_thread_init_callback (_client, jack_static_thread_init, NULL);
+    jack_set_buffer_size_callback (_client, jack_static_bufsize, (void *) this);
+    jack_set_sample_rate_callback (_client, jack_static_srate, (void *) this);
+    jack_set_process_callback (_client, jack_static_process, (void *) this);
+    jack_set_port_connect_callback (_client, jack_static_portconn, (void *) this);
+    jack_set_port_registration_callback (_client, jack_static_portreg, (void *) this);
+    jack_on_shutdown (_client, jack_static_shutdown, (void *) this);
+    jack_activate (_client);
+
+    _jack_name = jack_get_client_name (_client);
+    _jack_rate = jack_get_sample_rate (_client);
+    _jack_size = jack_get_buffer_size (_client);
+
+    pthread_getschedparam (jack_client_thread_id (_client), &_schedpol, &sched_par);
+    _priority = sched_par.sched_priority;
+
     return 0;
 }
 
@@ -138,12 +143,40 @@ int Jclient::jack_static_bufsize (jack_nframes_t nframes, void *arg)
 }
 
 
+int Jclient::jack_static_srate (jack_nframes_t fsamp, void *arg)
+{
+    return ((Jclient *) arg)->jack_srate (fsamp);
+}
+
+
 int Jclient::jack_static_process (jack_nframes_t nframes, void *arg)
 {
     return ((Jclient *) arg)->jack_process (nframes);
 }
 
 
+void Jclient::jack_static_portconn (jack_port_id_t a, jack_port_id_t b, int conn, void *arg)
+{
+    // Called from JACK's notification thread, not the process one.
+
+    Jclient *J = (Jclient *) arg;
+
+    J->jack_portconn (jack_port_by_id (J->_client, a), jack_port_by_id (J->_client, b), conn != 0);
+}
+
+
+void Jclient::jack_static_portreg (jack_port_id_t port, int reg, void *arg)
+{
+    // Called from JACK's notification thread, not the process one.
+    // No JACK server calls can be made from here, the handler can only
+    // pass the event on.
+
+    Jclient *J = (Jclient *) arg;
+
+    J->jack_portreg (jack_port_by_id (J->_client, port), reg != 0);
+}
+
+
 int Jclient::create_inp_port (int i, const char *name)
 {
     if ((i < 0) || (i >= _max_inps) || _inp_ports [i]) return -1;
@@ -47,6 +47,8 @@ public:
     int disconn_inp_port (int i, const char *srce);
     int disconn_out_port (int i, const char *dest);
 
+    jack_port_t *inp_port (int i) const { return _inp_ports [i]; }
+
     int max_inps (void) const { return _max_inps; }
     int max_outs (void) const { return _max_outs; }
 
@@ -57,7 +59,10 @@ protected:
 
     virtual void jack_shutdown (void) = 0;
     virtual int  jack_bufsize (int nframes) = 0;
+    virtual int  jack_srate (int fsamp) { _jack_rate = fsamp; return 0; }
     virtual int  jack_process (int nframes) = 0;
+    virtual void jack_portconn (jack_port_t *a, jack_port_t *b, bool conn) { (void) a; (void) b; (void) conn; }
+    virtual void jack_portreg (jack_port_t *port, bool reg) { (void) port; (void) reg; }
 
     jack_client_t   *_client;
     const char      *_jack_name;
@@ -77,7 +82,10 @@ private:
 
     static void jack_static_shutdown (void *arg);
     static int  jack_static_bufsize (jack_nframes_t nframes, void *arg);
+    static int  jack_static_srate (jack_nframes_t fsamp, void *arg);
     static int  jack_static_process (jack_nframes_t nframes, void *arg);
+    static void jack_static_portconn (jack_port_id_t a, jack_port_id_t b, int conn, void *arg);
+    static void jack_static_portreg (jack_port_id_t port, int reg, void *arg);
 };
 
 
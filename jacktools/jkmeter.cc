@@ -23,21 +23,56 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <math.h>
 #include "jkmeter.h"
 
 
-Jkmeter::Jkmeter (jack_client_t* client, int nchan, float *pks) :
+Jkmeter::Jkmeter (jack_client_t* client, int nchan, float *pks, int flags, int nprog, float *lus) :
     Jclient (client),
     _state (INITIAL),
+    _kproc (0),
+    _snap (0),
     _pks (pks),
-    _sem (NULL)
+    _nprog (0),
+    _lchan (0),
+    _lus (lus),
+    _clips (0),
+    _overs (0),
+    _times (0),
+    _cproc (0),
+    _npair (0),
+    _corr (0),
+    _bal (0),
+    _ring (0),
+    _pkp (0),
+    _delta (0),
+    _push (true),
+    _sem (NULL),
+    _regsem (NULL)
 {
     int   i;
     char  s [16];
 
+    memset (_nconn, 0, sizeof (_nconn));
     if (open_jack (nchan, 0)) return;
-    Kmeterdsp::init (_jack_rate, _jack_size, 0.5f, 40.0f);
-    _kproc = new Kmeterdsp [nchan];
+    _kproc = new Kmeterdsp (flags);
+    _kproc->init (_jack_rate);
+    _cproc = new Corrdsp ();
+    _cproc->init (_jack_rate);
+    // loudness of nprog programmes, each taking an equal share of the inputs
+    if (nprog > 0 && lus && nchan % nprog == 0 && nchan / nprog <= Lufsdsp::MAXCHAN)
+    {
+        _lchan = nchan / nprog;
+        for (i = 0; i < nprog; i++)
+        {
+            _lproc [i] = new Lufsdsp ();
+            _lproc [i]->init (_jack_rate);
+        }
+        _nprog = nprog;
+    }
+    _snap = new Peaksnap (nchan);
+    _pkp = new float [nchan];
+    memset (_pkp, 0, nchan * sizeof (float));
     for (i = 0; i < nchan; i++)
     {
         sprintf (s, "in_%d", i + 1);
@@ -52,7 +87,12 @@ Jkmeter::~Jkmeter (void)
     _state = INITIAL;
     usleep (100000);
     close_jack ();
-    delete[] _kproc;
+    delete _kproc;
+    delete _snap;
+    delete _cproc;
+    delete _ring;
+    for (int i = 0; i < _nprog; i++) delete _lproc [i];
+    delete[] _pkp;
 }
 
 
@@ -64,36 +104,85 @@ void Jkmeter::jack_shutdown (void)
 
 int Jkmeter::jack_bufsize (int nframes)
 {
+    // Meters work in sample time, any period size will do.
+
     _jack_size = nframes;
+    return 0;
+}
 
-    Kmeterdsp::init (_jack_rate, _jack_size, 0.25f, 30.0f);
 
-    for (int i = 0; i < _max_inps; i++)
-    {
-        _kproc [i].reset();
-    }
+int Jkmeter::jack_srate (int fsamp)
+{
+    // Called by JACK, possibly while the process callback runs on
+    // another thread. New coefficients are picked up at the next
+    // period, levels carry on.
+
+    _jack_rate = fsamp;
+    if (_kproc) _kproc->init (_jack_rate);
+    if (_cproc) _cproc->init (_jack_rate);
+    for (int i = 0; i < _nprog; i++) _lproc [i]->init (_jack_rate);
     return 0;
 }
 
 
 int Jkmeter::jack_process (int nframes)
 {
-    int    i, n = _max_inps;
-    float  *p;
+    int           i, n = _max_inps;
+    unsigned int  frame;
+    float         lev [MAXINP];
+    float         pk [MAXINP];
 
     if (_state != PROCESS) return 0;
     for (i = 0; i < n; i++)
     {
-        p = (float *) jack_port_get_buffer (_inp_ports [i], nframes);
-        _kproc [i].process (p, nframes);
+        // unconnected ports read as no signal, without touching their buffer
+        if (__atomic_load_n (_nconn + i, __ATOMIC_RELAXED) > 0)
+            _bufs [i] = (float *) jack_port_get_buffer (_inp_ports [i], nframes);
+        else
+            _bufs [i] = 0;
+    }
+    frame = jack_last_frame_time (_client);
+    _kproc->process (_bufs, n, nframes, frame);
+    for (i = 0; i < n; i++)
+    {
+        lev [i] = _kproc->read (i);
+        pk [i] = _kproc->period_peak (i);
+    }
+    _snap->publish (lev, pk, frame);
+    for (i = 0; i < _nprog; i++)
+    {
+        _lproc [i]->process (_bufs + i * _lchan, _lchan, nframes);
+    }
+    if (__atomic_load_n (&_npair, __ATOMIC_ACQUIRE))
+    {
+        _cproc->process (_bufs, _npair, nframes);
+    }
+    if (Audioring *R = __atomic_load_n (&_ring, __ATOMIC_ACQUIRE))
+    {
+        R->write (_bufs, nframes);
     }
 
     if (_sem)
     {
+        bool changed = _delta <= 0;
+
         for (i = 0; i < n; i++)
-            _pks[i] = _kproc [i].read ();
+        {
+            if (fabsf (lev[i] - _pkp[i]) >= _delta)
+            {
+                _pkp[i] = lev[i];
+                changed = true;
+            }
+        }
+        if (_push)
+        {
+            memcpy (_pks, lev, n * sizeof (float));
+            read_loudness ();
+            read_clips ();
+            read_corr ();
+        }
 
-        if (__sync_bool_compare_and_swap(_sem, 0, 1))
+        if (changed && __sync_bool_compare_and_swap(_sem, 0, 1))
             syscall(SYS_futex, _sem, FUTEX_WAKE, 1, nullptr, nullptr, 0);
     }
 
@@ -101,22 +190,176 @@ int Jkmeter::jack_process (int nframes)
 }
 
 
+static bool same_port (jack_port_t *P, jack_port_t *Q)
+{
+    // Port handles from jack_port_by_id() need not be the ones returned
+    // by jack_port_register(), so fall back to the names.
+
+    return Q && ((P == Q) || !strcmp (jack_port_name (P), jack_port_name (Q)));
+}
+
+
+void Jkmeter::jack_portconn (jack_port_t *a, jack_port_t *b, bool conn)
+{
+    // Counts connections of each input port, so the process callback
+    // knows which ports to skip without asking JACK every period.
+
+    for (int i = 0; i < _max_inps; i++)
+    {
+        jack_port_t *P = _inp_ports [i];
+
+        if (!P || !(same_port (P, a) || same_port (P, b))) continue;
+        if (conn) __atomic_add_fetch (_nconn + i, 1, __ATOMIC_RELAXED);
+        else if (__atomic_sub_fetch (_nconn + i, 1, __ATOMIC_RELAXED) < 0) __atomic_store_n (_nconn + i, 0, __ATOMIC_RELAXED);
+    }
+}
+
+
+void Jkmeter::jack_portreg (jack_port_t *port, bool reg)
+{
+    // Any port of any client, wakes whoever keeps our inputs connected.
+
+    (void) port;
+    (void) reg;
+
+    int *sem = __atomic_load_n (&_regsem, __ATOMIC_ACQUIRE);
+
+    if (sem && __sync_bool_compare_and_swap(sem, 0, 1))
+        syscall(SYS_futex, sem, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+
 int Jkmeter::get_levels (void)
 {
-    for (int i = 0; i < _max_inps; ++i)
-        _pks[i] = _kproc [i].read ();
+    // Levels of all inputs from the same period.
+
+    _snap->read (_pks);
+    read_loudness ();
+    read_clips ();
+    read_corr ();
     return _state;
 }
 
 
+int Jkmeter::get_levels (int reader, float *max)
+{
+    // As above, plus the largest peak of each input since the previous
+    // call with this reader, from add_reader(). Returns FAILED without
+    // reading anything if there is no such reader.
+
+    if (_snap->read (reader, _pks, max) < 0) return FAILED;
+    read_loudness ();
+    read_clips ();
+    read_corr ();
+    return _state;
+}
+
+
+void Jkmeter::read_loudness (void)
+{
+    for (int i = 0; i < _nprog; i++)
+    {
+        _lus [3 * i + 0] = _lproc [i]->momentary ();
+        _lus [3 * i + 1] = _lproc [i]->shortterm ();
+        _lus [3 * i + 2] = _lproc [i]->integrated ();
+    }
+}
+
+
+void Jkmeter::read_clips (void)
+{
+    if (!_clips) return;
+    for (int i = 0; i < _max_inps; i++)
+    {
+        // the count first, the time read after it is at least as new
+        _overs [i] = _kproc->overs (i);
+        _times [i] = _kproc->over_time (i);
+        _clips [i] = _kproc->clips (i);
+    }
+}
+
+
+void Jkmeter::read_corr (void)
+{
+    for (int i = 0; i < _npair; i++)
+    {
+        _corr [i] = _cproc->correlation (i);
+        _bal [i] = _cproc->balance (i);
+    }
+}
+
+
+void Jkmeter::reset_loudness (void)
+{
+    // Restarts the integrated loudness measurement of all programmes.
+
+    for (int i = 0; i < _nprog; i++) _lproc [i]->reset_integrated ();
+}
+
+
 int Jkmeter::get_state (void)
 {
     return _state;
 }
 
 
-void Jkmeter::setup_post (int* sem)
+void Jkmeter::setup_post (int* sem, float delta, bool push)
 {
+    // sem   : futex word, set to 1 and woken from the process callback
+    // delta : only post when a level moved by at least this much since
+    //         the previous post, 0 posts every period
+    // push  : also copy all results before posting, for readers that do
+    //         not call get_levels(); otherwise that is left to the reader,
+    //         and the process callback never writes to its arrays
+
+    _delta = delta;
+    _push = push;
     _sem = sem;
 }
 
+
+void Jkmeter::setup_portreg_post (int* sem)
+{
+    // sem : futex word, set to 1 and woken from JACK's notification
+    //       thread whenever a port is registered or unregistered
+
+    __atomic_store_n (&_regsem, sem, __ATOMIC_RELEASE);
+}
+
+
+void Jkmeter::setup_clips (unsigned int *clips, unsigned int *overs, unsigned int *times)
+{
+    // Arrays of max_inps() entries, updated along with the peaks: clipped
+    // samples and overs so far, and the frame time of the latest first
+    // over of a period.
+
+    _overs = overs;
+    _times = times;
+    _clips = clips;
+}
+
+
+void Jkmeter::setup_corr (int npair, float *corr, float *bal)
+{
+    // Correlation and balance of inputs 1-2, 3-4 and so on, in the same
+    // pass as the peaks. Call once, 0 pairs leaves the analysis off.
+
+    if (npair > _max_inps / 2) npair = _max_inps / 2;
+    if (npair > Corrdsp::MAXPAIR) npair = Corrdsp::MAXPAIR;
+    _corr = corr;
+    _bal = bal;
+    __atomic_store_n (&_npair, npair, __ATOMIC_RELEASE);
+}
+
+
+Audioring *Jkmeter::create_ring (int size)
+{
+    // Starts copying all inputs into a ring of at least 'size' frames,
+    // for analysis too heavy for the process callback. The ring is
+    // read by one worker thread and deleted with the meter. Call once.
+
+    Audioring *R = new Audioring (_max_inps, size);
+
+    __atomic_store_n (&_ring, R, __ATOMIC_RELEASE);
+    return R;
+}
@@ -23,7 +23,11 @@
 #define __JKMETER_H
 
 
+#include "audioring.h"
+#include "corrdsp.h"
 #include "kmeterdsp.h"
+#include "lufsdsp.h"
+#include "peaksnap.h"
 #include "jclient.h"
 
 
@@ -31,25 +35,59 @@ class Jkmeter : public Jclient
 {
 public:
 
-    Jkmeter (jack_client_t* client, int ninp, float *pks);
+    Jkmeter (jack_client_t* client, int ninp, float *pks, int flags = Kmeterdsp::FULL, int nprog = 0, float *lus = 0);
     virtual ~Jkmeter (void);
 
     enum { INITIAL, PASSIVE, SILENCE, PROCESS, FAILED = -1, ZOMBIE = -2, MAXINP = 64 };
 
     int get_levels (void);
+    int get_levels (int reader, float *max);
+    int add_reader (void) { return _snap->add_reader (); }
     int get_state (void);
-    void setup_post (int* sem);
+    void setup_post (int* sem, float delta = 0.0f, bool push = true);
+    void setup_portreg_post (int* sem);
+    void setup_clips (unsigned int *clips, unsigned int *overs, unsigned int *times);
+    void setup_corr (int npair, float *corr, float *bal);
+    Audioring *create_ring (int size);
+    void set_truepeak (int chan, bool on) { _kproc->set_truepeak (chan, on); }
+    void set_ballistics (float hold, float fall) { _kproc->set_ballistics (hold, fall); }
+    void reset_loudness (void);
 
 private:
 
     void jack_shutdown (void);
     int  jack_bufsize (int nfram);
+    int  jack_srate (int fsamp);
     int  jack_process (int nfram);
+    void jack_portconn (jack_port_t *a, jack_port_t *b, bool conn);
+    void jack_portreg (jack_port_t *port, bool reg);
+    void read_loudness (void);
+    void read_clips (void);
+    void read_corr (void);
 
     int              _state;
     Kmeterdsp       *_kproc;
+    Peaksnap        *_snap;   // levels of the last period, for get_levels()
+    float           *_bufs [MAXINP];  // port buffers of the current period
+    int              _nconn [MAXINP]; // connections per port, kept by jack_portconn()
     float           *_pks;
+    Lufsdsp         *_lproc [MAXINP];
+    int              _nprog;  // loudness programmes, each of _lchan consecutive inputs
+    int              _lchan;
+    float           *_lus;    // momentary, short-term and integrated loudness per programme
+    unsigned int    *_clips;  // clip counters per input, see Kmeterdsp
+    unsigned int    *_overs;
+    unsigned int    *_times;
+    Corrdsp         *_cproc;
+    int              _npair;  // stereo pairs analysed, inputs 2k and 2k+1
+    float           *_corr;   // correlation and balance per pair
+    float           *_bal;
+    Audioring       *_ring;   // copy of the input for a worker thread
+    float           *_pkp;    // levels at last post
+    float            _delta;  // minimum level change to post, 0 posts every period
+    bool             _push;   // copy all results when posting, not only in get_levels()
     int             *_sem;
+    int             *_regsem; // futex word, posted when any port comes or goes
 };
 
 
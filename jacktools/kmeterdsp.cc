@@ -21,23 +21,58 @@
 
 
 #include <math.h>
+#include <string.h>
 #include "kmeterdsp.h"
 
 
-int    Kmeterdsp::_hold;
-float  Kmeterdsp::_fall;
-float  Kmeterdsp::_wdcf;
-float  Kmeterdsp::_wrms;
+Kmeterdsp::vec4_t  Kmeterdsp::_tpfir [KMETERDSP_TP_TAPS];
 
 
 
-Kmeterdsp::Kmeterdsp (void) :
-    _z0 (0),
-    _z1 (0),
-    _z2 (0),
-    _dpk (0),
-    _cnt (0)
+Kmeterdsp::Kmeterdsp (int flags) :
+    _flags (flags & FULL),
+    _frame (0),
+    _sublen (KMETERDSP_HOLD_MINLEN),
+    _nsub (1),
+    _fall (1),
+    _wdcf (0),
+    _wrms (0),
+    _sil_n (0),
+    _sil_wdcf (0),
+    _sil_wrms (0),
+    _sil_dcf (1),
+    _sil_rms (1)
 {
+    static const bool tpfir = (design_tpfir (), true);
+    (void) tpfir;
+
+    Coeffs *C = _coef.edit ();
+    C->fsamp = 48000;
+    C->hold = 0.5f;
+    C->fall = 40.0f;
+    compute (C);
+    _coef.commit ();
+
+    memset (_tpon, 0, sizeof (_tpon));
+    switch (_flags)
+    {
+    case 0:
+        _group [0] = _group [1] = &Kmeterdsp::process_peak;
+        break;
+    case DCFILT:
+        _group [0] = &Kmeterdsp::process_group<DCFILT, false>;
+        _group [1] = &Kmeterdsp::process_group<DCFILT, true>;
+        break;
+    case BALLIST:
+        _group [0] = &Kmeterdsp::process_group<BALLIST, false>;
+        _group [1] = &Kmeterdsp::process_group<BALLIST, true>;
+        break;
+    default:
+        _group [0] = &Kmeterdsp::process_group<FULL, false>;
+        _group [1] = &Kmeterdsp::process_group<FULL, true>;
+        break;
+    }
+    reset ();
 }
 
 
@@ -48,93 +83,655 @@ Kmeterdsp::~Kmeterdsp (void)
 
 void Kmeterdsp::reset (void)
 {
-    _z0 = 0;
-    _z1 = 0;
-    _z2 = 0;
-    _dpk = 0;
-    _cnt = 0;
+    memset (_z0, 0, sizeof (_z0));
+    memset (_z1, 0, sizeof (_z1));
+    memset (_z2, 0, sizeof (_z2));
+    memset (_dpk, 0, sizeof (_dpk));
+    memset (_hpk, 0, sizeof (_hpk));
+    memset (_spk, 0, sizeof (_spk));
+    memset (_ppk, 0, sizeof (_ppk));
+    memset (_mpk, 0, sizeof (_mpk));
+    memset (_nclip, 0, sizeof (_nclip));
+    memset (_nover, 0, sizeof (_nover));
+    memset (_tover, 0, sizeof (_tover));
+    memset (_crun, 0, sizeof (_crun));
+    memset (_ccnt, 0, sizeof (_ccnt));
+    memset (_tph, 0, sizeof (_tph));
+    memset (_hqa, 0, sizeof (_hqa));
+    memset (_hqb, 0, sizeof (_hqb));
+    _sidx = 0;
+    _spos = 0;
 }
 
 
-void Kmeterdsp::process (float *p, int n)
+void Kmeterdsp::process (float * const *p, int nchan, int n, unsigned int frame)
 {
     // Called by JACK's process callback.
     //
-    // p : pointer to sample buffer
-    // n : number of samples to process
+    // p     : pointers to the sample buffers of all channels, a null
+    //         pointer clears the channel to no signal
+    // nchan : number of channels, at most MAXCHAN
+    // n     : number of samples to process
+    // frame : JACK frame time of the first sample, for over times
+
+    int     chan [MAXCHAN];
+    float  *q [MAXCHAN];
+    int     i, j, k, m, g, c;
+    bool    cc;
+
+    update ();
+    if (_spos >= _sublen) subblock (nchan);
+
+    // Channels carrying digital silence, with the DC filter settled,
+    // skip the per sample work. The peak-only kernel is no more than
+    // the silence scan itself, so it takes all channels.
+    for (i = k = 0; i < nchan; i++)
+    {
+        if (!p [i]) clear (i);
+        else if (_flags && silent (p [i], n) && (!(_flags & DCFILT) || fabsf (_z0 [i]) <= KMETERDSP_SILENCE))
+        {
+            process_silent (i, n);
+        }
+        else chan [k++] = i;
+        _mpk [i] = 0;
+        _pclip [i] = 0;
+        _pover [i] = 0;
+    }
+
+    // Split the period at sub-block boundaries, the peak hold works on
+    // sub-block peaks. Silent channels have no peak of their own, but
+    // their true-peak history still has to follow the input.
+    for (j = 0; j < n; j += m)
+    {
+        m = _sublen - _spos;
+        if (m > n - j) m = n - j;
+        _frame = frame + j;
+        for (i = 0; i < nchan; i++)
+        {
+            q [i] = p [i] ? p [i] + j : 0;
+            _ppk [i] = 0;
+        }
+
+        // A group counts clips in its loop if any of its channels
+        // clipped in the previous part.
+        for (i = 0; i < k; i += VECLEN)
+        {
+            g = (k - i < VECLEN) ? k - i : VECLEN;
+            for (c = 0, cc = false; c < g; c++) cc |= _ccnt [chan [i + c]];
+            (this->*_group [cc]) (q, chan + i, g, m);
+        }
+
+        for (i = 0; i < nchan; i++)
+        {
+            if (!q [i]) continue;
+            if (__atomic_load_n (_tpon + i, __ATOMIC_RELAXED))
+            {
+                const float tp = true_peak (i, q [i], m);
+                if (tp > _ppk [i]) _ppk [i] = tp;
+            }
+            if (_ppk [i] > _spk [i]) _spk [i] = _ppk [i];
+            if (_ppk [i] > _mpk [i]) _mpk [i] = _ppk [i];
+        }
+
+        _spos += m;
+        if (_spos == _sublen) subblock (nchan);
+    }
+
+    // Show the sub-block in progress as well, a new peak should not
+    // wait for the end of its sub-block. Clips counted by the kernels
+    // are published once per period, the over time is written before
+    // the count that makes it valid.
+    for (i = 0; i < nchan; i++)
+    {
+        _dpk [i] = (_spk [i] > _hpk [i]) ? _spk [i] : _hpk [i];
+        if (!_pclip [i]) continue;
+        __atomic_store_n (_nclip + i, _nclip [i] + _pclip [i], __ATOMIC_RELAXED);
+        if (_pover [i])
+        {
+            __atomic_store_n (_tover + i, _ptover [i], __ATOMIC_RELAXED);
+            __atomic_store_n (_nover + i, _nover [i] + _pover [i], __ATOMIC_RELEASE);
+        }
+    }
+}
+
+
+template <int FLAGS, bool CLIPS>
+void Kmeterdsp::process_group (float * const *p, const int *chan, int nchan, int n)
+{
+    // Processes up to VECLEN channels listed in 'chan', one channel per
+    // vector lane. Unused lanes repeat the first channel and their
+    // results are ignored. Filters not in FLAGS are compiled out.
+    //
+    // With CLIPS, clipped samples and overs are counted in the loop.
+    // Without, as long as nothing clips, only the unclamped peak is
+    // kept, and a channel that does reach full scale has this part
+    // counted sample by sample, the next ones are then taken with
+    // CLIPS. That keeps the loop short for the usual signal.
+
+    const float  *q [VECLEN];
+    const vec_t   lo = vec_t {} - 1.0f;
+    const vec_t   hi = vec_t {} + 1.0f;
+    const vec_t   cl = vec_t {} + KMETERDSP_CLIP;
+    const vec_t   ov = vec_t {} + KMETERDSP_OVER_RUN;
+    const vec_t   one = vec_t {} + 1.0f;
+    const vec_t   zero = {};
+    vec_t         a, t, u, z0, z1, z2;
+    vec_t         r, nc, no, to, jt;
+    int           c [VECLEN];
+    int           i, j, ncl, nov, tov;
 
-    float  s, t, z0, z1, z2;
+    for (i = 0; i < VECLEN; i++)
+    {
+        c [i] = chan [(i < nchan) ? i : 0];
+        q [i] = p [c [i]];
+    }
 
     // Get filter state.
-    z0 = _z0;
-    z1 = _z1;
-    z2 = _z2;
+    for (i = 0; i < VECLEN; i++)
+    {
+        z0 [i] = _z0 [c [i]];
+        z1 [i] = _z1 [c [i]];
+        z2 [i] = _z2 [c [i]];
+        r [i] = _crun [c [i]];
+    }
 
     // Process n samples. Find digital peak value for this
     // period and perform filtering on squared signal.
-    t = 0;
-    while (n--)
+    t = u = nc = no = jt = vec_t {};
+    to = vec_t {} - 1.0f;
+    for (j = 0; j < n; j++)
     {
-        s = *p++;
+        // Gather one sample per channel, starting from zero rather than
+        // the previous s so iterations do not depend on each other.
+        vec_t s = {};
+        for (i = 0; i < VECLEN; i++) s [i] = q [i][j];
 
-        if (s < -1.0f)
-            s = -1.0f;
-        else if (s > 1.0f)
-            s = 1.0f;
+        // Count clipped samples and runs of them. A run reaching
+        // KMETERDSP_OVER_RUN is an over, the sample index of the
+        // first one in each lane is kept. Counts are floats, exact
+        // for any period, so no integer vector support is needed.
+        a = (s < 0) ? -s : s;
+        if (CLIPS)
+        {
+            r = (a < cl) ? zero : r + one;
+            nc += (a < cl) ? zero : one;
+            to = (r == ov && to < zero) ? jt : to;
+            no += (r == ov) ? one : zero;
+            jt += one;
+        }
+        else u = (u < a) ? a : u;
 
-        z0 += _wdcf * (s - z0);      // DC filter
-        s -= z0;
+        s = (lo < s) ? s : lo;       // Clamp to [-1, 1],
+        s = (s < hi) ? s : hi;       // as max/min.
+        if (FLAGS & DCFILT)
+        {
+            z0 += _wdcf * (s - z0);  // DC filter
+            s -= z0;
+        }
         s *= s;
-        if (t < s) t = s;            // Update digital peak.
-        z1 += _wrms * (s - z1);      // Update first filter.
-        z2 += _wrms * (z1 - z2);     // Update second filter.
+        t = (t < s) ? s : t;         // Update digital peak.
+        if (FLAGS & BALLIST)
+        {
+            z1 += _wrms * (s - z1);  // Update first filter.
+            z2 += _wrms * (z1 - z2); // Update second filter.
+        }
     }
-    t = sqrtf (t);
 
     // Save filter state.
-    _z0 = z0;
-    _z1 = z1;
-    _z2 = z2;
+    for (i = 0; i < nchan; i++)
+    {
+        if (FLAGS & DCFILT) _z0 [c [i]] = z0 [i];
+        if (FLAGS & BALLIST)
+        {
+            _z1 [c [i]] = z1 [i];
+            _z2 [c [i]] = z2 [i];
+        }
+        _ppk [c [i]] = sqrtf (t [i]);
+        if (CLIPS)
+        {
+            _crun [c [i]] = r [i];
+            _ccnt [c [i]] = nc [i] > 0;
+            add_clips (c [i], nc [i], no [i], to [i]);
+        }
+        else if (u [i] >= KMETERDSP_CLIP)
+        {
+            ncl = nov = tov = 0;
+            _crun [c [i]] = count_clips (q [i], 0, n, 0, &ncl, &nov, &tov);
+            _ccnt [c [i]] = true;
+            add_clips (c [i], ncl, nov, tov);
+        }
+    }
+}
 
-    // Digital peak hold and fallback.
-    if (t > _dpk)
+
+void Kmeterdsp::process_peak (float * const *p, const int *chan, int nchan, int n)
+{
+    // Peak only, no filter state at all. Every channel is scanned on
+    // its own for the largest magnitude. Clips are counted in the same
+    // scan if the channel clipped in the previous part, otherwise a
+    // part reaching full scale is counted sample by sample.
+
+    float  pk;
+    int    i, c, r, ncl, nov, tov;
+
+    for (i = 0; i < nchan; i++)
+    {
+        c = chan [i];
+        r = _crun [c];
+        ncl = nov = tov = 0;
+        if (_ccnt [c]) pk = absmax_clips (p [c], n, &r, &ncl, &nov, &tov);
+        else
+        {
+            pk = absmax (p [c], n);
+            if (pk >= KMETERDSP_CLIP) r = count_clips (p [c], 0, n, r, &ncl, &nov, &tov);
+        }
+        _ppk [c] = (pk < 1.0f) ? pk : 1.0f;
+        _crun [c] = r;
+        _ccnt [c] = ncl > 0;
+        add_clips (c, ncl, nov, tov);
+    }
+}
+
+
+void Kmeterdsp::clear (int chan)
+{
+    _z0 [chan] = 0;
+    _z1 [chan] = 0;
+    _z2 [chan] = 0;
+    _dpk [chan] = 0;
+    _hpk [chan] = 0;
+    _spk [chan] = 0;
+    _ppk [chan] = 0;
+    _hqa [chan] = _hqb [chan];
+    _crun [chan] = 0;
+    _ccnt [chan] = false;
+    memset (_tph [chan], 0, sizeof (_tph [chan]));
+}
+
+
+void Kmeterdsp::process_silent (int chan, int n)
+{
+    // With zero input every filter is a pure exponential decay, n samples
+    // of it take a single multiplication. The second ballistic filter is
+    // fed by the first one with the same pole, which adds a term linear
+    // in n. The resulting peak is zero.
+
+    if ((n != _sil_n) || (_wdcf != _sil_wdcf) || (_wrms != _sil_wrms))
+    {
+        _sil_n = n;
+        _sil_wdcf = _wdcf;
+        _sil_wrms = _wrms;
+        _sil_dcf = powf (1 - _wdcf, n);
+        _sil_rms = powf (1 - _wrms, n);
+    }
+
+    if (_flags & DCFILT) _z0 [chan] *= _sil_dcf;
+    if (_flags & BALLIST)
+    {
+        _z2 [chan] = _sil_rms * (_z2 [chan] + n * _wrms * _z1 [chan]);
+        _z1 [chan] *= _sil_rms;
+    }
+    _ppk [chan] = 0;
+    _crun [chan] = 0;
+    _ccnt [chan] = false;
+}
+
+
+bool Kmeterdsp::silent (const float *p, int n)
+{
+    // Returns true if no sample reaches KMETERDSP_SILENCE. The first
+    // few samples are checked on their own so that a channel with
+    // signal is rejected without scanning the rest.
+
+    const int k = (n < VECLEN) ? n : VECLEN;
+
+    return (absmax (p, k) < KMETERDSP_SILENCE) && (absmax (p + k, n - k) < KMETERDSP_SILENCE);
+}
+
+
+float Kmeterdsp::absmax (const float *p, int n)
+{
+    // Largest magnitude in p, four independent maxima keep the loop
+    // from waiting on each one.
+
+    vec_t  s, t [4] = {};
+    float  m = 0;
+    int    i, j;
+
+    for (j = 0; j + 4 * VECLEN <= n; j += 4 * VECLEN)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            memcpy (&s, p + j + i * VECLEN, sizeof (vec_t));
+            s = (s < 0) ? -s : s;
+            t [i] = (t [i] < s) ? s : t [i];
+        }
+    }
+    for (; j < n; j++) if (m < fabsf (p [j])) m = fabsf (p [j]);
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < VECLEN; j++) if (m < t [i][j]) m = t [i][j];
+    }
+    return m;
+}
+
+
+float Kmeterdsp::absmax_clips (const float *p, int n, int *run, int *nclip, int *nover, int *tover)
+{
+    // As absmax(), also counting clipped samples and overs the way
+    // count_clips() does, for a run of '*run' clipped samples before
+    // p [0], which is updated. Past the first KMETERDSP_OVER_RUN
+    // samples, a sample ends an over if it and the ones just before it
+    // make a run of that length, with an unclipped sample before. That
+    // is found for a vector of samples at once from shifted loads, and
+    // the run at the end needs no more than the last few samples.
+
+    enum { R = KMETERDSP_OVER_RUN };
+
+    const vec_t  cl = vec_t {} + KMETERDSP_CLIP;
+    const vec_t  one = vec_t {} + 1.0f;
+    const vec_t  zero = {};
+    vec_t        s, t, v, nc, no, to, jv;
+    float        m = 0;
+    int          i, j, k, nv;
+
+    j = (n < R) ? n : R;
+    for (i = 0; i < j; i++) if (m < fabsf (p [i])) m = fabsf (p [i]);
+    *run = count_clips (p, 0, j, *run, nclip, nover, tover);
+
+    if (j + VECLEN <= n)
     {
-        // If higher than current value, update and set hold counter.
-        _dpk = t;
-        _cnt = _hold;
+        t = nc = no = vec_t {};
+        to = vec_t {} + (float) n;
+        for (i = 0; i < VECLEN; i++) jv [i] = j + i;
+        for (; j + VECLEN <= n; j += VECLEN)
+        {
+            memcpy (&s, p + j, sizeof (vec_t));
+            s = (s < 0) ? -s : s;
+            t = (t < s) ? s : t;
+            v = (s < cl) ? zero : one;
+            nc += v;
+            for (k = 1; k <= R; k++)
+            {
+                memcpy (&s, p + j - k, sizeof (vec_t));
+                s = (s < 0) ? -s : s;
+                if (k < R) v = (s < cl) ? zero : v;
+                else v = (s < cl) ? v : zero;
+            }
+            no += v;
+            to = (v > zero && jv < to) ? jv : to;
+            jv += (float) VECLEN;
+        }
+
+        for (i = nv = 0, k = n; i < VECLEN; i++)
+        {
+            if (m < t [i]) m = t [i];
+            if (k > to [i]) k = (int) to [i];
+            *nclip += (int) nc [i];
+            nv += (int) no [i];
+        }
+        if (nv && !*nover) *tover = k;
+        *nover += nv;
+
+        for (k = 0; k < R && fabsf (p [j - k - 1]) >= KMETERDSP_CLIP; k++);
+        *run = k;
+    }
+
+    for (i = j; i < n; i++) if (m < fabsf (p [i])) m = fabsf (p [i]);
+    *run = count_clips (p, j, n, *run, nclip, nover, tover);
+    return m;
+}
+
+
+float Kmeterdsp::true_peak (int chan, const float *p, int n)
+{
+    // Returns the largest magnitude of the 4x oversampled signal, or 0
+    // if nothing reaches the gate. Input is not clamped here, overs
+    // above full scale show as values above 1.
+    //
+    // Output phase k of input sample m lies between x [m-6] and
+    // x [m-5], so it is computed only if one of these reaches the gate.
+    // All four phases are one vector, one multiply-add per tap.
+    // The zeros past the end of a chunk only feed outputs that are
+    // dropped.
+
+    enum { T = KMETERDSP_TP_TAPS, H = KMETERDSP_TP_TAPS - 1, CHUNK = 256 };
+
+    float   x [H + CHUNK + 3];
+    float  *h = _tph [chan];
+    vec4_t  tp = {};
+    vec4_t  y [4];
+    int     i, j, k, m;
+
+    if ((absmax (p, n) < KMETERDSP_TP_GATE) && (absmax (h, H) < KMETERDSP_TP_GATE))
+    {
+        // Just keep the history.
+        if (n >= H) memcpy (h, p + n - H, H * sizeof (float));
+        else
+        {
+            memmove (h, h + n, (H - n) * sizeof (float));
+            memcpy (h + H - n, p, n * sizeof (float));
+        }
+        return 0;
+    }
+
+    memcpy (x, h, H * sizeof (float));
+    for (j = 0; j < n; j += m)
+    {
+        m = (n - j < CHUNK) ? n - j : CHUNK;
+        memcpy (x + H, p + j, m * sizeof (float));
+        memset (x + H + m, 0, 3 * sizeof (float));
+
+        // x [k + H] is the newest input sample for output k. Outputs
+        // are taken in fours, as independent sums, if any needs it.
+        for (k = 0; k < m; k += 4)
+        {
+            const int    r = (m - k < 4) ? m - k : 4;
+            const float *w = x + k;
+            float        g = 0;
+
+            for (i = H - 6; i < H - 5 + r; i++) if (g < fabsf (w [i])) g = fabsf (w [i]);
+            if (g < KMETERDSP_TP_GATE) continue;
+
+            y [0] = y [1] = y [2] = y [3] = vec4_t {};
+            for (i = 0; i < T; i++)
+            {
+                for (int o = 0; o < 4; o++) y [o] += _tpfir [i] * w [H - i + o];
+            }
+            for (int o = 0; o < r; o++)
+            {
+                y [o] = (y [o] < 0) ? -y [o] : y [o];
+                tp = (tp < y [o]) ? y [o] : tp;
+            }
+        }
+        memmove (x, x + m, H * sizeof (float));
     }
-    else if (_cnt) _cnt--; // else decrement counter if not zero,
-    else
+    memcpy (h, x, H * sizeof (float));
+
+    for (i = 1; i < 4; i++) if (tp [0] < tp [i]) tp [0] = tp [i];
+    return tp [0];
+}
+
+
+void Kmeterdsp::add_clips (int chan, int nclip, int nover, int tover)
+{
+    // Adds the clips found by a kernel in the current part of a period.
+    // 'tover' is the sample index in the part at which the first over
+    // reached its length, a run continued from before may then start
+    // before the part or even the period.
+
+    _pclip [chan] += nclip;
+    if (nover && !_pover [chan]) _ptover [chan] = _frame + tover - (KMETERDSP_OVER_RUN - 1);
+    _pover [chan] += nover;
+}
+
+
+int Kmeterdsp::count_clips (const float *p, int j, int n, int r, int *nclip, int *nover, int *tover)
+{
+    // Counts clipped samples and overs in p [j] to p [n - 1], one by
+    // one, for a run of 'r' clipped samples before them. Returns the
+    // run at the end.
+
+    for (; j < n; j++)
     {
-        _dpk *= _fall;     // else let the peak value fall back,
+        if (fabsf (p [j]) < KMETERDSP_CLIP)
+        {
+            r = 0;
+            continue;
+        }
+        (*nclip)++;
+        if (++r == KMETERDSP_OVER_RUN)
+        {
+            if (!*nover) *tover = j;
+            (*nover)++;
+        }
     }
+    return r;
+}
+
+
+void Kmeterdsp::subblock (int nchan)
+{
+    // End of a sub-block, at the same sample time for all channels.
+
+    for (int i = 0; i < nchan; i++)
+    {
+        hold (i, _spk [i]);
+        _spk [i] = 0;
+    }
+    _sidx++;
+    _spos = 0;
+}
+
+
+void Kmeterdsp::hold (int chan, float pk)
+{
+    // Digital peak hold and fallback.
+    //
+    // The ring keeps the sub-block peaks of the window that are larger
+    // than every later one, so its front is the window maximum. A new
+    // peak removes the smaller ones at the back, the front is removed
+    // when it leaves the window. Each peak goes in and out once.
+
+    float        *v = _hqv [chan];
+    unsigned int *t = _hqt [chan];
+    unsigned int  a = _hqa [chan];
+    unsigned int  b = _hqb [chan];
+    float         h;
+
+    while ((b != a) && (v [(b - 1) % HOLDQ] <= pk)) b--;
+    v [b % HOLDQ] = pk;
+    t [b % HOLDQ] = _sidx;
+    b++;
+    while (_sidx - t [a % HOLDQ] >= (unsigned int) _nsub) a++;
+    _hqa [chan] = a;
+    _hqb [chan] = b;
+
+    // Held while in the window, then let the peak value fall back.
+    h = _hpk [chan] * _fall;
+    _hpk [chan] = (v [a % HOLDQ] > h) ? v [a % HOLDQ] : h;
 }
 
 
-float Kmeterdsp::read (void)
+void Kmeterdsp::set_truepeak (int chan, bool on)
+{
+    // Can be called from any thread. The history of a channel that is
+    // switched on may be stale, which affects its first period only.
+
+    __atomic_store_n (_tpon + chan, on, __ATOMIC_RELAXED);
+}
+
+
+float Kmeterdsp::read (int chan)
 {
     // Called by display process approx. 30 times per second.
     //
-    // Returns current _dpk value.
+    // Returns current _dpk value of channel 'chan'.
 
-    return _dpk;
+    return _dpk [chan];
 }
 
 
-void Kmeterdsp::init (int fsamp, int fsize, float hold, float fall)
+void Kmeterdsp::init (int fsamp)
 {
-    // Called by initialisation code.
+    // Called by initialisation code, and on sample rate changes.
     //
     // fsamp = sample frequency
-    // fsize = period size
+
+    Coeffs *C = _coef.edit ();
+    C->fsamp = fsamp;
+    compute (C);
+    _coef.commit ();
+}
+
+
+void Kmeterdsp::set_ballistics (float hold, float fall)
+{
     // hold  = peak hold time, seconds
     // fall  = peak fallback rate, dB/s
 
-    float t;
+    Coeffs *C = _coef.edit ();
+    C->hold = hold;
+    C->fall = fall;
+    compute (C);
+    _coef.commit ();
+}
+
+
+void Kmeterdsp::update (void)
+{
+    // Picks up coefficients changed since the previous period.
+
+    const Coeffs *C = _coef.fetch ();
+
+    if (!C) return;
+    _sublen = C->sublen;
+    _nsub = C->nsub;
+    _fall = C->mfall;
+    _wdcf = C->wdcf;
+    _wrms = C->wrms;
+}
+
 
-    _wdcf = 5 * 6.28f / fsamp;                 // dc filter coefficient
-    _wrms = 9.72f / fsamp;                     // ballistic filter coefficient
-    t = (float) fsize / fsamp;                 // period time in seconds
-    _hold = (int)(hold / t + 0.5f);            // number of periods to hold peak
-    _fall = powf (10.0f, -0.05f * fall * t);   // per period fallback multiplier
+void Kmeterdsp::compute (Coeffs *C)
+{
+    float h;
+    int   k;
+
+    C->wdcf = 5 * 6.28f / C->fsamp;                   // dc filter coefficient
+    C->wrms = 9.72f / C->fsamp;                       // ballistic filter coefficient
+    h = C->hold * C->fsamp;                           // hold time in samples
+    k = (int)(h / KMETERDSP_HOLD_NSUB + 0.5f);        // sub-block length
+    C->sublen = (k > KMETERDSP_HOLD_MINLEN) ? k : KMETERDSP_HOLD_MINLEN;
+    k = (int)(h / C->sublen + 0.5f);                  // number of sub-blocks to hold peak
+    C->nsub = (k < 1) ? 1 : ((k > KMETERDSP_HOLD_NSUB) ? KMETERDSP_HOLD_NSUB : k);
+    C->mfall = powf (10.0f, -0.05f * C->fall * C->sublen / C->fsamp);   // per sub-block fallback multiplier
+}
+
+
+void Kmeterdsp::design_tpfir (void)
+{
+    // True-peak interpolator: Blackman windowed sinc with the cutoff at
+    // the input Nyquist frequency, every phase scaled to unity gain at
+    // DC. Tap n of the 4x filter is tap n / 4 of phase n % 4. The same
+    // for all sample rates.
+
+    const int   N = 4 * KMETERDSP_TP_TAPS;
+    const float c = 0.5f * (N - 1);
+
+    for (int k = 0; k < 4; k++)
+    {
+        float sum = 0;
+
+        for (int i = 0; i < KMETERDSP_TP_TAPS; i++)
+        {
+            const int   n = 4 * i + k;
+            const float x = (float) M_PI * (n - c) / 4;
+            const float w = 0.42f - 0.5f * cosf (2 * (float) M_PI * n / (N - 1)) + 0.08f * cosf (4 * (float) M_PI * n / (N - 1));
+
+            _tpfir [i][k] = w * sinf (x) / x;
+            sum += _tpfir [i][k];
+        }
+        for (int i = 0; i < KMETERDSP_TP_TAPS; i++) _tpfir [i][k] /= sum;
+    }
 }
@@ -24,30 +24,173 @@
 #define __KMETERDSP_H
 
 
+#include "coeffbox.h"
+
+
+// Number of channels processed together, one SIMD register worth.
+// GCC vector extensions map this to SSE/AVX on x86 and NEON on ARM,
+// and to plain scalar code where neither is enabled.
+
+#if defined(__AVX__)
+#define KMETERDSP_VECLEN 8
+#else
+#define KMETERDSP_VECLEN 4
+#endif
+
+
+// Inputs and DC filter state below this are taken as digital silence,
+// for which filter state is advanced in closed form (-120 dB).
+
+#define KMETERDSP_SILENCE 1e-6f
+
+
+// True peak: 4x oversampling by a polyphase FIR with this many taps per
+// phase. Only the neighbourhood of samples reaching the gate (-6 dBFS)
+// is interpolated, quieter ones cannot hide an inter-sample over.
+
+#define KMETERDSP_TP_TAPS 12
+#define KMETERDSP_TP_GATE 0.5f
+
+
+// Peak hold: the hold time is split into this many sub-blocks, and the
+// held value is the largest sub-block peak within the last hold time,
+// whatever the period size. Sub-blocks are never shorter than
+// KMETERDSP_HOLD_MINLEN samples.
+
+#define KMETERDSP_HOLD_NSUB   32
+#define KMETERDSP_HOLD_MINLEN 16
+
+
+// Samples at or above full scale, less half a 16 bit step, count as
+// clipped. A run of KMETERDSP_OVER_RUN of them is one over.
+
+#define KMETERDSP_CLIP     0.99998f
+#define KMETERDSP_OVER_RUN 3
+
+
 class Kmeterdsp
 {
 public:
 
-    Kmeterdsp (void);
+    enum { VECLEN = KMETERDSP_VECLEN, MAXCHAN = 64, HOLDQ = 64 };
+
+    // Processing stages, the peak is always measured. Without any of
+    // them the peak is a plain clamp and abs-max over the samples.
+    enum { DCFILT = 1, BALLIST = 2, FULL = DCFILT | BALLIST };
+
+    Kmeterdsp (int flags = FULL);
     ~Kmeterdsp (void);
 
     void reset (void);
-    void process (float *p, int n);
-    float read (void);
+    void process (float * const *p, int nchan, int n, unsigned int frame = 0);
+    float read (int chan);
+
+    // Largest peak of the last period, without hold, for readers that
+    // accumulate their own maximum. Read by the process callback only.
+    float period_peak (int chan) const { return _mpk [chan]; }
+
+    // Clip counters since construction, they only go up and wrap. The
+    // frame time is that of the first over in the last period with
+    // overs, valid once overs() is not zero.
+    unsigned int clips (int chan) const { return __atomic_load_n (_nclip + chan, __ATOMIC_RELAXED); }
+    unsigned int overs (int chan) const { return __atomic_load_n (_nover + chan, __ATOMIC_ACQUIRE); }
+    unsigned int over_time (int chan) const { return __atomic_load_n (_tover + chan, __ATOMIC_RELAXED); }
+    int flags (void) const { return _flags; }
+
+    // Per channel true-peak mode, may be changed while processing.
+    void set_truepeak (int chan, bool on);
+    bool truepeak (int chan) const { return _tpon [chan]; }
 
-    static void init (int fsamp, int fsize, float hold, float fall);
+    // Setup, from any non-RT thread while processing. Changes take
+    // effect at the next period, no state is reset.
+    void init (int fsamp);
+    void set_ballistics (float hold, float fall);
 
 private:
 
-    float          _z0, _z1, _z2;  // filter state
-    float          _dpk;           // current digital peak value
-    int            _cnt;	   // digital peak hold counter
+    struct Coeffs
+    {
+        int    fsamp;          // sample frequency
+        float  hold;           // peak hold time, seconds
+        float  fall;           // peak fallback rate, dB/s
+        int    sublen;         // derived from the above
+        int    nsub;
+        float  mfall;
+        float  wdcf;
+        float  wrms;
+    };
+
+    typedef float vec_t __attribute__ ((vector_size (VECLEN * sizeof (float))));
+    typedef float vec4_t __attribute__ ((vector_size (4 * sizeof (float))));
+
+    typedef void (Kmeterdsp::*group_fn) (float * const *p, const int *chan, int nchan, int n);
+
+    template <int FLAGS, bool CLIPS> void process_group (float * const *p, const int *chan, int nchan, int n);
+    void process_peak (float * const *p, const int *chan, int nchan, int n);
+    void process_silent (int chan, int n);
+    void update (void);
+    static void compute (Coeffs *C);
+    static void design_tpfir (void);
+    void clear (int chan);
+    float true_peak (int chan, const float *p, int n);
+    void add_clips (int chan, int nclip, int nover, int tover);
+    static int count_clips (const float *p, int j, int n, int r, int *nclip, int *nover, int *tover);
+    void subblock (int nchan);
+    void hold (int chan, float pk);
+    static bool silent (const float *p, int n);
+    static float absmax (const float *p, int n);
+    static float absmax_clips (const float *p, int n, int *run, int *nclip, int *nover, int *tover);
+
+    int            _flags;
+    group_fn       _group [2];     // process_group variants for _flags, without and with clip counting
+
+    // Filter state, one array per variable, gathered into vector
+    // lanes once per period.
+    float          _z0 [MAXCHAN];
+    float          _z1 [MAXCHAN];
+    float          _z2 [MAXCHAN];
+    float          _dpk [MAXCHAN];     // current digital peak value
+    float          _hpk [MAXCHAN];     // held or falling peak of the past sub-blocks
+    float          _spk [MAXCHAN];     // peak of the current sub-block
+    float          _ppk [MAXCHAN];     // peak of the current part of a period
+    float          _mpk [MAXCHAN];     // peak of the current period
+    unsigned int   _nclip [MAXCHAN];   // clipped samples
+    unsigned int   _nover [MAXCHAN];   // overs
+    unsigned int   _tover [MAXCHAN];   // frame time of the latest first over
+    int            _crun [MAXCHAN];    // clipped samples in a row, up to the current sample
+    bool           _ccnt [MAXCHAN];    // clips in the last part, kernels count them
+    unsigned int   _pclip [MAXCHAN];   // clipped samples in the current period
+    unsigned int   _pover [MAXCHAN];   // overs in the current period
+    unsigned int   _ptover [MAXCHAN];  // frame time of the first of them
+    unsigned int   _frame;             // frame time of the current part of a period
+    bool           _tpon [MAXCHAN];    // true-peak mode
+    float          _tph [MAXCHAN][KMETERDSP_TP_TAPS - 1];  // true-peak input history
+
+    // Running maximum of the sub-block peaks in the hold window, as a
+    // ring of decreasing values. Entries between _hqa and _hqb, mod
+    // HOLDQ, with the sub-block number each was taken in.
+    float          _hqv [MAXCHAN][HOLDQ];
+    unsigned int   _hqt [MAXCHAN][HOLDQ];
+    unsigned int   _hqa [MAXCHAN];
+    unsigned int   _hqb [MAXCHAN];
+    unsigned int   _sidx;              // number of the current sub-block
+    int            _spos;              // samples in the current sub-block
+
+    // Coefficients in use, from the last update().
+    Coeffbox<Coeffs> _coef;
+    int            _sublen;        // samples per sub-block
+    int            _nsub;          // number of sub-blocks to hold peak value
+    float          _fall;          // per sub-block fallback multiplier for peak value
+    float          _wdcf;          // dc filter coefficient
+    float          _wrms;          // ballistic filter coefficient.
 
+    // Filter decay over a silent period of _sil_n samples, for the
+    // coefficients they were computed with.
+    int            _sil_n;
+    float          _sil_wdcf, _sil_wrms;
+    float          _sil_dcf, _sil_rms;
 
-    static int     _hold;          // number of JACK periods to hold peak value
-    static float   _fall;          // per period fallback multiplier for peak value
-    static float   _wdcf;          // dc filter coefficient
-    static float   _wrms;          // ballistic filter coefficient.
+    static vec4_t  _tpfir [KMETERDSP_TP_TAPS];  // one tap of each of the 4 phases
 };
 
 
@@ -0,0 +1,260 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#include <math.h>
+#include <string.h>
+#include "lufsdsp.h"
+
+
+Lufsdsp::Lufsdsp (void) :
+    _b0 (1), _b1 (0), _b2 (0), _a1 (0), _a2 (0),
+    _h1 (0), _h2 (0),
+    _blen (4800)
+{
+    for (int i = 0; i < MAXCHAN; i++) _gain [i] = 1.0f;
+    init (48000);
+    reset ();
+}
+
+
+Lufsdsp::~Lufsdsp (void)
+{
+}
+
+
+void Lufsdsp::init (int fsamp)
+{
+    // Called by initialisation code.
+    //
+    // fsamp = sample frequency
+    //
+    // The K-weighting filters of BS.1770 are given for 48 kHz only.
+    // These are the analog prototypes they were derived from, mapped
+    // by the bilinear transform, which reproduces the 48 kHz table.
+
+    Coeffs *C = _coef.edit ();
+    double  k, q, vh, vb, a0;
+
+    k = tan (M_PI * 1681.974450955533 / fsamp);
+    q = 0.7071752369554196;
+    vh = pow (10.0, 3.999843853973347 / 20);
+    vb = pow (vh, 0.4996667741545416);
+    a0 = 1 + k / q + k * k;
+    C->b0 = (vh + vb * k / q + k * k) / a0;
+    C->b1 = 2 * (k * k - vh) / a0;
+    C->b2 = (vh - vb * k / q + k * k) / a0;
+    C->a1 = 2 * (k * k - 1) / a0;
+    C->a2 = (1 - k / q + k * k) / a0;
+
+    k = tan (M_PI * 38.13547087602444 / fsamp);
+    q = 0.5003270373238773;
+    a0 = 1 + k / q + k * k;
+    C->h1 = 2 * (k * k - 1) / a0;
+    C->h2 = (1 - k / q + k * k) / a0;
+
+    C->blen = (fsamp + 5) / 10;
+    _coef.commit ();
+}
+
+
+void Lufsdsp::update (void)
+{
+    // Picks up coefficients changed since the previous period. A block
+    // already longer than the new length ends here.
+
+    const Coeffs *C = _coef.fetch ();
+
+    if (!C) return;
+    _b0 = C->b0;
+    _b1 = C->b1;
+    _b2 = C->b2;
+    _a1 = C->a1;
+    _a2 = C->a2;
+    _h1 = C->h1;
+    _h2 = C->h2;
+    _blen = C->blen;
+    if (_bpos >= _blen) block ();
+}
+
+
+void Lufsdsp::reset (void)
+{
+    memset (_z, 0, sizeof (_z));
+    memset (_blk, 0, sizeof (_blk));
+    memset (_hcnt, 0, sizeof (_hcnt));
+    memset (_hsum, 0, sizeof (_hsum));
+    _bpos = 0;
+    _acc = 0;
+    _bidx = 0;
+    _nblk = 0;
+    _htot = 0;
+    _hall = 0;
+    _irst = 0;
+    _mom = _sht = _int = LUFSDSP_FLOOR;
+}
+
+
+void Lufsdsp::reset_integrated (void)
+{
+    // Can be called from any thread, takes effect at the next block.
+
+    __atomic_store_n (&_irst, 1, __ATOMIC_RELEASE);
+}
+
+
+void Lufsdsp::process (float * const *p, int nchan, int n)
+{
+    // Called by JACK's process callback.
+    //
+    // p     : pointers to the sample buffers of the programme channels,
+    //         a null pointer is a channel without signal
+    // nchan : number of channels, at most MAXCHAN
+    // n     : number of samples to process
+
+    int    i, j, k;
+    float  b0, b1, b2, a1, a2, h1, h2;
+    float  x, y, w, s, z0, z1, z2, z3;
+
+    update ();
+    b0 = _b0;
+    b1 = _b1;
+    b2 = _b2;
+    a1 = _a1;
+    a2 = _a2;
+    h1 = _h1;
+    h2 = _h2;
+
+    for (j = 0; n; j += k, n -= k)
+    {
+        // Split the period at block boundaries.
+        k = _blen - _bpos;
+        if (k > n) k = n;
+
+        for (i = 0; i < nchan; i++)
+        {
+            const float *q = p [i];
+            float       *z = _z [i];
+
+            if (!q)
+            {
+                z [0] = z [1] = z [2] = z [3] = 0;
+                continue;
+            }
+            q += j;
+            z0 = z [0];
+            z1 = z [1];
+            z2 = z [2];
+            z3 = z [3];
+            s = 0;
+            for (int t = 0; t < k; t++)
+            {
+                // Transposed direct form II, shelf then high pass.
+                x = q [t];
+                y = b0 * x + z0;
+                z0 = b1 * x - a1 * y + z1;
+                z1 = b2 * x - a2 * y;
+                w = y + z2;
+                z2 = -2 * y - h1 * w + z3;
+                z3 = y - h2 * w;
+                s += w * w;
+            }
+            // Flush the state to zero before it can turn denormal.
+            if (fabsf (z0) + fabsf (z1) + fabsf (z2) + fabsf (z3) < 1e-20f) z0 = z1 = z2 = z3 = 0;
+            z [0] = z0;
+            z [1] = z1;
+            z [2] = z2;
+            z [3] = z3;
+            _acc += _gain [i] * s;
+        }
+
+        _bpos += k;
+        if (_bpos == _blen) block ();
+    }
+}
+
+
+void Lufsdsp::block (void)
+{
+    // End of a 100 ms block. Gating blocks are 400 ms long and overlap
+    // by 75%, so each one is the momentary loudness of a block end.
+
+    double  e, m, s;
+    int     i, b;
+
+    if (__atomic_exchange_n (&_irst, 0, __ATOMIC_ACQUIRE))
+    {
+        memset (_hcnt, 0, sizeof (_hcnt));
+        memset (_hsum, 0, sizeof (_hsum));
+        _htot = 0;
+        _hall = 0;
+        _int = LUFSDSP_FLOOR;
+    }
+
+    _blk [_bidx] = _acc / _blen;
+    _acc = 0;
+    _bpos = 0;
+    if (++_bidx == SBLK) _bidx = 0;
+    if (_nblk < SBLK) _nblk++;
+
+    // Windows not yet filled count as silence.
+    m = s = 0;
+    for (i = 0; i < MBLK; i++) m += _blk [(_bidx + SBLK - 1 - i) % SBLK];
+    for (i = 0; i < SBLK; i++) s += _blk [i];
+    m /= MBLK;
+    s /= SBLK;
+    _mom = lufs (m);
+    _sht = lufs (s);
+    if (_nblk < MBLK) return;
+
+    // Absolute gate.
+    e = _mom;
+    if (e < LUFSDSP_HIST_MIN) return;
+    b = (int)((e - LUFSDSP_HIST_MIN) / LUFSDSP_HIST_STEP);
+    if (b >= LUFSDSP_HIST_BINS) b = LUFSDSP_HIST_BINS - 1;
+    _hcnt [b]++;
+    _hsum [b] += m;
+    _htot++;
+    _hall += m;
+
+    // Relative gate, 10 dB below the loudness of all blocks above the
+    // absolute gate. Its own bin is taken whole, an error of at most
+    // one bin width in the gate level.
+    e = lufs (_hall / _htot) - 10.0;
+    b = (int)((e - LUFSDSP_HIST_MIN) / LUFSDSP_HIST_STEP);
+    if (b < 0) b = 0;
+    if (b >= LUFSDSP_HIST_BINS) b = LUFSDSP_HIST_BINS - 1;
+    m = 0;
+    i = 0;
+    for (; b < LUFSDSP_HIST_BINS; b++)
+    {
+        i += _hcnt [b];
+        m += _hsum [b];
+    }
+    _int = i ? lufs (m / i) : LUFSDSP_FLOOR;
+}
+
+
+float Lufsdsp::lufs (double e)
+{
+    // Loudness of a weighted mean square sum.
+
+    return (e > 0) ? (float)(-0.691 + 10 * log10 (e)) : LUFSDSP_FLOOR;
+}
@@ -0,0 +1,111 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+#ifndef __LUFSDSP_H
+#define __LUFSDSP_H
+
+
+#include "coeffbox.h"
+
+
+// Loudness reported while nothing has been measured, in LUFS.
+
+#define LUFSDSP_FLOOR -120.0f
+
+
+// Integrated loudness histogram: 0.1 dB bins from the absolute gate
+// up. Louder blocks go into the top bin, with their true energy.
+
+#define LUFSDSP_HIST_MIN  -70.0f
+#define LUFSDSP_HIST_STEP  0.1f
+#define LUFSDSP_HIST_BINS  750
+
+
+// ITU-R BS.1770 loudness of one programme of up to MAXCHAN channels:
+// momentary (400 ms), short-term (3 s) and gated integrated loudness.
+// Levels are updated every 100 ms block. Integrated loudness keeps a
+// fixed-size histogram of block energies, so memory does not grow with
+// the measurement time.
+
+class Lufsdsp
+{
+public:
+
+    enum { MAXCHAN = 8, MBLK = 4, SBLK = 30 };
+
+    Lufsdsp (void);
+    ~Lufsdsp (void);
+
+    // Sample rate, from any non-RT thread while processing. Takes
+    // effect at the next period, no state is reset.
+    void init (int fsamp);
+    void reset (void);
+    void reset_integrated (void);
+    void process (float * const *p, int nchan, int n);
+
+    void set_weight (int chan, float w) { _gain [chan] = w; }
+
+    float momentary (void) const { return _mom; }
+    float shortterm (void) const { return _sht; }
+    float integrated (void) const { return _int; }
+
+private:
+
+    struct Coeffs
+    {
+        float  b0, b1, b2, a1, a2;
+        float  h1, h2;
+        int    blen;
+    };
+
+    void update (void);
+    void block (void);
+    static float lufs (double e);
+
+    // K-weighting, a high shelf followed by a high pass, each one
+    // biquad. The high pass numerator is 1, -2, 1. Copied from _coef
+    // by update().
+    Coeffbox<Coeffs> _coef;
+    float          _b0, _b1, _b2, _a1, _a2;
+    float          _h1, _h2;
+    float          _z [MAXCHAN][4];
+    float          _gain [MAXCHAN];    // channel weights, 1.41 for surrounds
+
+    int            _blen;              // samples per 100 ms block
+    int            _bpos;              // samples in the current block
+    double         _acc;               // weighted energy of the current block
+    double         _blk [SBLK];        // mean square of the last blocks
+    int            _bidx;              // next index into _blk
+    int            _nblk;              // blocks since reset, saturates at SBLK
+
+    unsigned int   _hcnt [LUFSDSP_HIST_BINS];
+    double         _hsum [LUFSDSP_HIST_BINS];
+    unsigned int   _htot;              // gating blocks above the absolute gate
+    double         _hall;              // their total energy
+    int            _irst;              // reset_integrated() request
+
+    float          _mom;
+    float          _sht;
+    float          _int;
+};
+
+
+#endif
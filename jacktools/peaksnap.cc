@@ -0,0 +1,130 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+
+#include <sched.h>
+#include <string.h>
+#include "peaksnap.h"
+
+
+Peaksnap::Peaksnap (int nchan) :
+    _seq (0),
+    _frame (0),
+    _nchan (nchan),
+    _nreader (0)
+{
+    if (_nchan > MAXCHAN) _nchan = MAXCHAN;
+    memset (_lev, 0, sizeof (_lev));
+    memset (_max, 0, sizeof (_max));
+}
+
+
+Peaksnap::~Peaksnap (void)
+{
+}
+
+
+void Peaksnap::publish (const float *lev, const float *pk, unsigned int frame)
+{
+    // Called by JACK's process callback, once per period.
+    //
+    // lev   : levels to show, as read from the meter
+    // pk    : peak of this period only, for the readers' maxima
+    // frame : JACK frame time of the period
+
+    const unsigned int s = _seq;
+    const int          r = __atomic_load_n (&_nreader, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n (&_seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    memcpy (_lev, lev, _nchan * sizeof (float));
+    _frame = frame;
+    __atomic_store_n (&_seq, s + 2, __ATOMIC_RELEASE);
+
+    // A reader can only clear its maximum, so a failed exchange is
+    // retried at most once. Most periods are no new maximum, and leave
+    // the reader's cache line alone.
+    for (int i = 0; i < r; i++)
+    {
+        for (int c = 0; c < _nchan; c++)
+        {
+            const unsigned int v = bits (pk [c]);
+            unsigned int       m = __atomic_load_n (_max [i] + c, __ATOMIC_RELAXED);
+
+            while (v > m && !__atomic_compare_exchange_n (_max [i] + c, &m, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+        }
+    }
+}
+
+
+int Peaksnap::add_reader (void)
+{
+    // Returns the reader number for read (), or -1 if there are
+    // MAXREADER already. Readers are never removed.
+
+    int r = __atomic_load_n (&_nreader, __ATOMIC_RELAXED);
+
+    while (r < MAXREADER)
+    {
+        if (__atomic_compare_exchange_n (&_nreader, &r, r + 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) return r;
+    }
+    return -1;
+}
+
+
+unsigned int Peaksnap::read (float *lev, unsigned int *frame)
+{
+    // Copies the levels of the last period, all from the same one. The
+    // writer takes a small fraction of a period, a reader that keeps
+    // running into it yields now and then.
+
+    unsigned int s, t, f;
+
+    for (int n = 0;; n++)
+    {
+        if (n && !(n & 15)) sched_yield ();
+        s = __atomic_load_n (&_seq, __ATOMIC_ACQUIRE);
+        if (s & 1) continue;
+        memcpy (lev, _lev, _nchan * sizeof (float));
+        f = _frame;
+        __atomic_thread_fence (__ATOMIC_ACQUIRE);
+        t = __atomic_load_n (&_seq, __ATOMIC_RELAXED);
+        if (s == t) break;
+    }
+    if (frame) *frame = f;
+    return s / 2;
+}
+
+
+int Peaksnap::read (int reader, float *lev, float *max, unsigned int *frame)
+{
+    // As above, and also takes the largest period peaks since the
+    // previous call for the same reader, from add_reader (). Nothing
+    // is copied for a reader that was not added.
+
+    if (reader < 0 || reader >= __atomic_load_n (&_nreader, __ATOMIC_ACQUIRE)) return -1;
+    read (lev, frame);
+    for (int c = 0; c < _nchan; c++)
+    {
+        max [c] = value (__atomic_exchange_n (_max [reader] + c, 0, __ATOMIC_RELAXED));
+    }
+    return 0;
+}
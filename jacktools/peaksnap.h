@@ -0,0 +1,83 @@
+// ------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+// ------------------------------------------------------------------------
+
+
+
+#ifndef __PEAKSNAP_H
+#define __PEAKSNAP_H
+
+
+// Size of a cache line, data written by the process callback is kept
+// apart from everything else by at least this much.
+
+#define PEAKSNAP_LINE 64
+
+
+// Levels of all channels, published once per period by the process
+// callback and read as one consistent frame by any number of threads.
+// A sequence lock: the writer never waits, a reader that overlaps a
+// write retries.
+//
+// Registered readers also get the largest period peak of each channel
+// since their previous read, so a transient shorter than the time
+// between two reads is never missed, whatever the hold time. Each
+// maximum is taken and cleared on its own, a period that ends during
+// a read may count for the next read in some channels only.
+
+class Peaksnap
+{
+public:
+
+    enum { MAXCHAN = 64, MAXREADER = 4 };
+
+    Peaksnap (int nchan);
+    ~Peaksnap (void);
+
+    int nchan (void) const { return _nchan; }
+
+    // writer side
+    void publish (const float *lev, const float *pk, unsigned int frame);
+
+    // reader side, read() returns the number of periods published so
+    // far, or with a reader 0, and -1 if that reader does not exist
+    int add_reader (void);
+    unsigned int read (float *lev, unsigned int *frame = 0);
+    int read (int reader, float *lev, float *max, unsigned int *frame = 0);
+
+private:
+
+    // Peaks are never negative, their bit patterns order like unsigned
+    // integers, which have atomic exchange.
+    static unsigned int bits (float v) { union { float f; unsigned int u; } x; x.f = v; return x.u; }
+    static float value (unsigned int v) { union { unsigned int u; float f; } x; x.u = v; return x.f; }
+
+    char             _pad0 [PEAKSNAP_LINE];
+    unsigned int     _seq;                // odd while a write is in progress
+    unsigned int     _frame;              // JACK frame time of the period
+    float            _lev [MAXCHAN];
+    char             _pad1 [PEAKSNAP_LINE];
+    unsigned int     _max [MAXREADER][MAXCHAN];  // since the last read, as bits ()
+    char             _pad2 [PEAKSNAP_LINE];
+    int              _nchan;
+    int              _nreader;
+};
+
+
+#endif
@@ -0,0 +1,415 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+// Replays synthetic peak streams through the LED mapping into an emulated PCA9685 and reports the resulting i2c
+// traffic, so changes to the LED pipeline can be measured without MOD hardware.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "jacktools/kmeterdsp.h"
+#include "ledtools/ledcolortable.h"
+#include "ledtools/ledmapper.h"
+#include "ledtools/ledrate.h"
+#include "ledtools/ledscheduler.h"
+#include "ledtools/pca9685.h"
+#include "ledtools/pca9685emu.h"
+
+// --------------------------------------------------------------------------------------------------------------------
+// Synthetic peak streams
+
+enum Stream {
+    kStreamSilence,
+    kStreamSteady,
+    kStreamMusic,
+    kStreamClipping,
+    kStreamCount
+};
+
+static const char* const kStreamNames[kStreamCount] = {
+    "silence",
+    "steady",
+    "music",
+    "clipping",
+};
+
+struct StreamState {
+    uint32_t seed;
+    float levels[Ledlayout::MAXMETER];
+};
+
+static float random_float(StreamState& state)
+{
+    state.seed = state.seed * 1664525u + 1013904223u;
+    return float(state.seed >> 8) / float(1 << 24);
+}
+
+static void next_peaks(const Stream stream, StreamState& state, const float frame_time, float* const pks, const int nmeter)
+{
+    for (int i=0; i<nmeter; ++i)
+    {
+        switch (stream)
+        {
+        case kStreamSilence:
+            pks[i] = 0.0f;
+            break;
+
+        case kStreamSteady:
+            pks[i] = 0.25f;
+            break;
+
+        case kStreamMusic:
+            // random hits, roughly 2 per second per meter, decaying at ~20 dB/s in between
+            if (random_float(state) < 2.0f * frame_time)
+                state.levels[i] = 0.2f + 0.75f * random_float(state);
+            else
+                state.levels[i] *= 1.0f - 2.3f * frame_time;
+            pks[i] = state.levels[i] * (0.9f + 0.1f * random_float(state));
+            break;
+
+        case kStreamClipping:
+            pks[i] = random_float(state) < 0.5f ? 1.0f : 0.7f + 0.2f * random_float(state);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// Benchmark
+
+static const char* const kModeNames[] = {
+    "byte-data",
+    "i2c-block",
+    "i2c-rdwr",
+};
+
+static const unsigned long kModeFuncs[] = {
+    I2C_FUNC_SMBUS_BYTE_DATA,
+    I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_I2C_BLOCK,
+    I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_I2C_BLOCK | I2C_FUNC_I2C,
+};
+
+// the MOD layout, and one spread over 2 buses with 2 chips each, the same address on both buses
+// and gaps between the meters so every chip takes several writes per frame
+static const char* const kLayoutNames[] = {
+    "mod",
+    "2x2chips",
+};
+
+static const char* const kLayoutSpecs[] = {
+    nullptr,
+    "0:0x40:0:1 0:0x40:3:4 0:0x40:6:7 0:0x40:9:10 0:0x40:12:13 "
+    "0:0x41:0:1 0:0x41:5:6 0:0x41:10:11 0:0x41:14:15 "
+    "1:0x40:1:2 1:0x40:4:5 1:0x40:8:9 1:0x40:12:13 "
+    "1:0x43:0:1 1:0x43:2:3 1:0x43:4:5 1:0x43:6:7 1:0x43:8:9 1:0x43:10:11 1:0x43:12:13 1:0x43:14:15",
+};
+
+enum { kLayoutCount = sizeof(kLayoutSpecs) / sizeof(kLayoutSpecs[0]) };
+
+// bus cost of init_led_chip, on a chip fresh from power-on and on one a previous instance already set up
+static bool init_cost(const LED_WriteMode mode)
+{
+    Pca9685emu bus(kModeFuncs[mode]);
+    bool warm[2];
+
+    bus.add_chip(PCA9685_ADDR);
+
+    for (int i=0; i<2; ++i)
+    {
+        bus.reset_stats();
+
+        if (! init_led_chip(&bus, PCA9685_ADDR, false, &warm[i]))
+        {
+            fprintf(stderr, "init failed\n");
+            return false;
+        }
+
+        printf("init %-9s %-5s %4lu ioctls %5lu bytes %8.1f us @100kHz\n",
+               kModeNames[mode], warm[i] ? "warm" : "cold", bus.stats().ioctls,
+               bus.stats().bytes, 1e6 * bus.stats().bus_time(100000));
+    }
+
+    return !warm[0] && warm[1];
+}
+
+// an fs/4 sine at 45 degrees peaks between the samples, 3 dB above them, the clip LED must light without any clipped
+// sample, from the peak level the same way the plugin takes it
+static bool truepeak_clip()
+{
+    const float amp = 1.25f;
+    float buf[256];
+    float* const bufs[1] = { buf };
+    float pks[2];
+
+    for (int k=0; k<256; ++k)
+        buf[k] = amp * std::sin(float(M_PI) * (0.25f + 0.5f * k));
+
+    for (int tp=0; tp<2; ++tp)
+    {
+        Kmeterdsp dsp(Kmeterdsp::DCFILT);
+        dsp.init(48000);
+        dsp.set_truepeak(0, tp != 0);
+
+        for (int i=0; i<100; ++i)
+            dsp.process(bufs, 1, 256);
+        pks[tp] = dsp.read(0);
+
+        if (dsp.clips(0) != 0)
+        {
+            fprintf(stderr, "true-peak over counted %u clipped samples\n", dsp.clips(0));
+            return false;
+        }
+    }
+
+    Ledlayout layout;
+    Ledmapper mapper;
+    Ledframe frame;
+    layout.set_default(0);
+    mapper.setup(&layout);
+
+    const bool clipping[2] = { pks[1] > LED_LEVEL_CLIP, false };
+    const float levels[2] = { pks[1], 0.0f };
+    mapper.process(levels, &frame, 0.025f, clipping);
+
+    const Ledlayout::Meter& meter(layout.meter(0));
+    const bool lit = frame.pwm[meter.chip][meter.red] == MAX_BRIGHTNESS_RED && frame.pwm[meter.chip][meter.green] == 0;
+
+    printf("true-peak over: sample peak %.3f, true peak %.3f, clip LED %s\n", pks[0], pks[1], lit ? "on" : "off");
+
+    return pks[0] < LED_LEVEL_CLIP && lit;
+}
+
+// running time on an emulated bus at 100kHz, in us, for Ledscheduler::calibrate
+static double bus_clock(I2Cbus* const bus)
+{
+    return 1e6 * static_cast<Pca9685emu*>(bus)->stats().bus_time(100000);
+}
+
+static bool run(const int layoutidx, const Stream stream, const LED_WriteMode mode, const bool adaptive,
+                const float seconds, const float fps, float budget)
+{
+    Ledlayout layout;
+
+    if (kLayoutSpecs[layoutidx] == nullptr)
+        layout.set_default(0);
+    else if (layout.parse(kLayoutSpecs[layoutidx]) != 0)
+        return false;
+
+    // one emulated bus per layout bus, holding the chips of the layout
+    Pca9685emu* buses[Ledlayout::MAXBUS];
+    bool warm;
+
+    for (int b=0; b<layout.nbus(); ++b)
+        buses[b] = new Pca9685emu(kModeFuncs[mode]);
+
+    for (int c=0; c<layout.nchip(); ++c)
+        buses[layout.chip(c).bus]->add_chip(layout.chip(c).addr);
+
+    // same state jack_initialize_leds leaves the chips in
+    for (int c=0; c<layout.nchip(); ++c)
+    {
+        if (! init_led_chip(buses[layout.chip(c).bus], layout.chip(c).addr, false, &warm))
+        {
+            fprintf(stderr, "init failed for chip %d\n", c);
+            for (int b=0; b<layout.nbus(); ++b)
+                delete buses[b];
+            return false;
+        }
+    }
+
+    Ledmapper mapper;
+    Ledrate rate;
+    Ledscheduler scheduler;
+    Ledframe frame, next, cache;
+    std::memset(&cache, 0, sizeof(cache));
+    mapper.setup(&layout);
+    scheduler.set_budget(budget);
+    // measured only with a budget, as Ledwriter::start does
+    int failed = 0;
+    if (budget <= 0.0f)
+        scheduler.estimate(mode, 100000);
+    else if (! scheduler.calibrate(buses[0], mode, &layout, 0, &cache, bus_clock, &failed))
+    {
+        fprintf(stderr, "calibration failed\n");
+        for (int b=0; b<layout.nbus(); ++b)
+            delete buses[b];
+        return false;
+    }
+
+    // raised to fit a single write, as Ledwriter::start does
+    if (budget > 0.0f && budget < scheduler.min_budget())
+    {
+        budget = std::ceil(scheduler.min_budget());
+        scheduler.set_budget(budget);
+    }
+
+    for (int b=0; b<layout.nbus(); ++b)
+        buses[b]->reset_stats();
+
+    // same intervals as the plugin, with the normal one taken from fps, and the same floor as Ledwriter::min_interval
+    float floor_us = 0.0f;
+    for (int b=0; b<layout.nbus(); ++b)
+    {
+        const float cost = scheduler.frame_cost(&layout, b);
+        floor_us = std::max(floor_us, budget > 0.0f ? std::min(budget, cost) : cost);
+    }
+
+    const int normal = int(1000.0f / fps + 0.5f);
+    rate.setup(std::min(10, normal), normal, std::max(250, normal), int(std::ceil(floor_us * 1e-3f)));
+
+    StreamState state;
+    std::memset(&state, 0, sizeof(state));
+    state.seed = 1;
+
+    float pks[Ledlayout::MAXMETER];
+    float frame_time = 1.0f / fps;
+    int frames = 0, mismatches = 0;
+    double error = 0.0;
+    bool ok = true;
+
+    for (float t=0.0f; ok && t<seconds; t+=frame_time, ++frames)
+    {
+        next_peaks(stream, state, frame_time, pks, layout.nmeter());
+        mapper.process(pks, &frame, frame_time);
+
+        if (adaptive)
+            frame_time = 0.001f * rate.update(pks, layout.nmeter(), &frame);
+
+        for (int b=0; b<layout.nbus(); ++b)
+        {
+            scheduler.select(&layout, b, &frame, &cache, &next);
+
+            if (! commit_led_frame(buses[b], mode, &layout, b, &next, &cache))
+            {
+                fprintf(stderr, "commit failed at frame %d\n", frames);
+                ok = false;
+                break;
+            }
+        }
+
+        // every chip must hold what the cache says, and differ from the frame only where the budget ran out
+        for (int k=0; k<layout.nchip(); ++k)
+        {
+            const Pca9685emu* const bus = buses[layout.chip(k).bus];
+            const int addr = layout.chip(k).addr;
+
+            for (int c=0; c<Ledframe::NCHAN; ++c)
+            {
+                if (bus->pwm_off(addr, c) != cache.pwm[k][c])
+                    ++mismatches;
+                if (budget <= 0.0f && cache.pwm[k][c] != frame.pwm[k][c])
+                    ++mismatches;
+                error += std::fabs(Ledscheduler::lightness(cache.pwm[k][c]) - Ledscheduler::lightness(frame.pwm[k][c]));
+            }
+        }
+    }
+
+    // traffic is the sum over all buses, occupancy that of the busiest one, as the buses run in parallel
+    I2Cstats stats;
+    unsigned long busiest = 0;
+    std::memset(&stats, 0, sizeof(stats));
+
+    for (int b=0; b<layout.nbus(); ++b)
+    {
+        stats.ioctls   += buses[b]->stats().ioctls;
+        stats.messages += buses[b]->stats().messages;
+        stats.bytes    += buses[b]->stats().bytes;
+        stats.bits     += buses[b]->stats().bits;
+        busiest = std::max(busiest, buses[b]->stats().bits);
+        delete buses[b];
+    }
+
+    if (! ok)
+        return false;
+
+    // a bus busy for more than the run time could never have kept up
+    const double occupancy = 100.0 * busiest / 100000 / seconds;
+
+    // LEDs that should change but never get written have stalled
+    const double dL = error / (frames * layout.nchip() * Ledframe::NCHAN);
+    const bool stalled = stream != kStreamSilence && stats.bytes == 0 && dL > 0.0;
+
+    printf("%-9s %-9s %-9s %-8s %10.1f %10.1f %10.1f %10.1f %9.2f%% %9.2f%% %8.3f%s%s%s\n",
+           kLayoutNames[layoutidx], kStreamNames[stream], kModeNames[mode], adaptive ? "adaptive" : "fixed",
+           frames / seconds, stats.ioctls / seconds, stats.messages / seconds, stats.bytes / seconds,
+           occupancy, 100.0 * busiest / 400000 / seconds, dL,
+           mismatches != 0 ? "  MISMATCH" : "",
+           occupancy > 100.0 ? "  OVERLOAD" : "",
+           stalled ? "  STALLED" : "");
+
+    return mismatches == 0 && occupancy <= 100.0 && ! stalled;
+}
+
+int main(int argc, char* argv[])
+{
+    const float seconds = argc > 1 ? std::atof(argv[1]) : 60.0f;
+    const float fps     = argc > 2 ? std::atof(argv[2]) : 40.0f;
+    const float budget  = argc > 3 ? std::atof(argv[3]) : 0.0f;
+
+    if (seconds <= 0.0f || fps <= 0.0f || budget < 0.0f)
+    {
+        fprintf(stderr, "usage: %s [seconds] [frames-per-second] [bus-budget-us]\n", argv[0]);
+        return 1;
+    }
+
+    bool ok = true;
+
+    for (int m=kLedWriteByteData; m<=kLedWriteRdWr; ++m)
+        ok = init_cost(LED_WriteMode(m)) && ok;
+    printf("\n");
+
+    ok = truepeak_clip() && ok;
+    printf("\n");
+
+    if (budget > 0.0f)
+        printf("%.0f s at %.0f fps, %.0f us of bus time per frame at 100kHz\n\n", seconds, fps, budget);
+    else
+        printf("%.0f s at %.0f fps\n\n", seconds, fps);
+    printf("%-9s %-9s %-9s %-8s %10s %10s %10s %10s %10s %10s %8s\n",
+           "layout", "stream", "mode", "rate", "frames/s", "ioctl/s", "msgs/s", "bytes/s", "@100kHz", "@400kHz", "dL*");
+
+    for (int l=0; l<kLayoutCount; ++l)
+        for (int s=0; s<kStreamCount; ++s)
+            for (int m=kLedWriteByteData; m<=kLedWriteRdWr; ++m)
+                for (int a=0; a<2; ++a)
+                    ok = run(l, Stream(s), LED_WriteMode(m), a != 0, seconds, fps, budget) && ok;
+
+    return ok ? 0 : 1;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+
+#include "jacktools/kmeterdsp.cc"
+#include "ledtools/i2cbus.cc"
+#include "ledtools/ledframe.cc"
+#include "ledtools/ledlayout.cc"
+#include "ledtools/ledmapper.cc"
+#include "ledtools/ledrate.cc"
+#include "ledtools/ledscheduler.cc"
+#include "ledtools/pca9685.cc"
+#include "ledtools/pca9685emu.cc"
+
+// --------------------------------------------------------------------------------------------------------------------
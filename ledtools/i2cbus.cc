@@ -0,0 +1,100 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "i2cbus.h"
+
+
+I2Cdevbus::I2Cdevbus (void) :
+    _fd (-1)
+{
+}
+
+
+I2Cdevbus::~I2Cdevbus (void)
+{
+    close_bus ();
+}
+
+
+int I2Cdevbus::open_bus (int number)
+{
+    char path [24];
+
+    close_bus ();
+    snprintf (path, sizeof (path), "/dev/i2c-%d", number);
+    _fd = ::open (path, O_RDWR);
+    return (_fd < 0) ? -1 : 0;
+}
+
+
+void I2Cdevbus::close_bus (void)
+{
+    if (_fd >= 0) ::close (_fd);
+    _fd = -1;
+}
+
+
+int I2Cdevbus::set_address (int addr)
+{
+    if (ioctl (_fd, I2C_SLAVE, addr) < 0) return -1;
+    _addr = addr;
+    return 0;
+}
+
+
+unsigned long I2Cdevbus::functionality (void)
+{
+    unsigned long funcs = 0;
+
+    if (ioctl (_fd, I2C_FUNCS, &funcs) < 0) return 0;
+    return funcs;
+}
+
+
+int I2Cdevbus::read_byte_data (uint8_t reg)
+{
+    return i2c_smbus_read_byte_data (_fd, reg);
+}
+
+
+int I2Cdevbus::write_byte_data (uint8_t reg, uint8_t value)
+{
+    return i2c_smbus_write_byte_data (_fd, reg, value);
+}
+
+
+int I2Cdevbus::write_i2c_block_data (uint8_t reg, uint8_t length, const uint8_t *values)
+{
+    return i2c_smbus_write_i2c_block_data (_fd, reg, length, values);
+}
+
+
+int I2Cdevbus::transfer (struct i2c_msg *msgs, int nmsgs)
+{
+    struct i2c_rdwr_ioctl_data rdwr;
+
+    rdwr.msgs = msgs;
+    rdwr.nmsgs = nmsgs;
+    return ioctl (_fd, I2C_RDWR, &rdwr);
+}
@@ -0,0 +1,88 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __I2CBUS_H
+#define __I2CBUS_H
+
+
+#include <stdint.h>
+
+extern "C" {
+#include "../i2c-dev.h"
+}
+
+
+// Abstract access to a single slave on an i2c bus.
+// Methods follow the i2c_smbus_* helpers from i2c-dev.h, including
+// their return values: negative on error, read data otherwise.
+
+class I2Cbus
+{
+public:
+
+    I2Cbus (void) : _addr (0) {}
+    virtual ~I2Cbus (void) {}
+
+    int address (void) const { return _addr; }
+
+    virtual int set_address (int addr) = 0;
+    virtual unsigned long functionality (void) = 0;
+
+    virtual int read_byte_data (uint8_t reg) = 0;
+    virtual int write_byte_data (uint8_t reg, uint8_t value) = 0;
+    virtual int write_i2c_block_data (uint8_t reg, uint8_t length, const uint8_t *values) = 0;
+
+    // plain i2c messages, sent as one combined transaction (I2C_RDWR)
+    virtual int transfer (struct i2c_msg *msgs, int nmsgs) = 0;
+
+protected:
+
+    int              _addr;
+};
+
+
+// Linux i2c-dev backend, /dev/i2c-N.
+
+class I2Cdevbus : public I2Cbus
+{
+public:
+
+    I2Cdevbus (void);
+    virtual ~I2Cdevbus (void);
+
+    int open_bus (int number);
+    void close_bus (void);
+
+    int set_address (int addr);
+    unsigned long functionality (void);
+
+    int read_byte_data (uint8_t reg);
+    int write_byte_data (uint8_t reg, uint8_t value);
+    int write_i2c_block_data (uint8_t reg, uint8_t length, const uint8_t *values);
+    int transfer (struct i2c_msg *msgs, int nmsgs);
+
+private:
+
+    int              _fd;
+};
+
+
+#endif
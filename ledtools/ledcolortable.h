@@ -0,0 +1,119 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __LEDCOLORTABLE_H
+#define __LEDCOLORTABLE_H
+
+
+#include <stdint.h>
+
+
+// Brightness values
+#define MIN_BRIGHTNESS_GREEN 120
+#define MIN_BRIGHTNESS_RED   120
+#define MAX_BRIGHTNESS_RED   1024
+
+#define MIN_BRIGHTNESS_GREEN_f 120.f
+#define MIN_BRIGHTNESS_RED_f   120.f
+
+// Level thresholds
+#define LED_LEVEL_OFF  0.009f  // x < -40dB, off
+#define LED_LEVEL_CLIP 0.988f  // clipping
+
+
+// Red and green PWM values for one level.
+
+struct Ledcolor
+{
+    uint16_t red;
+    uint16_t green;
+};
+
+
+// Brightness curves, applied to the 0..1 position inside a colour band.
+
+enum LED_Curve {
+    kLedCurveLinear,  // PWM duty proportional to level, as the original mapping
+    kLedCurveCIE      // constant steps in CIE 1931 lightness, looks even at low brightness
+};
+
+
+// Level to colour table, generated at compile time.
+// Entry i holds the colour for a (smoothed) peak level of i / (SIZE - 1),
+// following the same bands as the original branch ladder:
+//
+//   level <  0.009  (-40 dB)  off
+//   level <  0.5    ( -6 dB)  green, 10 .. MIN_BRIGHTNESS_GREEN
+//   level <  0.9    ( -1 dB)  green + red, 10 .. MIN_BRIGHTNESS_RED (yellow)
+//   otherwise                 red
+
+template <int SIZE, LED_Curve CURVE>
+class Ledcolortable
+{
+public:
+
+    enum { size = SIZE };
+
+    constexpr Ledcolortable (void) : _colors ()
+    {
+        for (int i = 0; i < SIZE; i++)
+        {
+            _colors [i] = compute ((float) i / (SIZE - 1));
+        }
+    }
+
+    // v must already be clamped to 0..1
+    const Ledcolor& lookup (float v) const
+    {
+        return _colors [(int)(v * (SIZE - 1) + 0.5f)];
+    }
+
+    constexpr const Ledcolor& operator[] (int i) const { return _colors [i]; }
+
+private:
+
+    static constexpr float curve (float p)
+    {
+        // Inverse of CIE 1931 lightness, L* = 100 p gives relative luminance.
+        return (CURVE == kLedCurveLinear) ? p
+             : (p <= 0.08f) ? p * 100.0f / 903.3f
+             : ((p * 100.0f + 16.0f) / 116.0f) * ((p * 100.0f + 16.0f) / 116.0f) * ((p * 100.0f + 16.0f) / 116.0f);
+    }
+
+    static constexpr uint16_t band (float v, float imin, float imax, float omin, float omax)
+    {
+        return (uint16_t)(omin + (omax - omin) * curve ((v - imin) / (imax - imin)));
+    }
+
+    static constexpr Ledcolor compute (float v)
+    {
+        return (v < LED_LEVEL_OFF) ? Ledcolor { 0, 0 }
+             : (v < 0.5f)           ? Ledcolor { 0, band (v, 0.0f, 0.5f, 10.f, MIN_BRIGHTNESS_GREEN_f) }
+             : (v < 0.9f)           ? Ledcolor { band (v, 0.5f, 0.9f, 10.f, MIN_BRIGHTNESS_RED_f), MIN_BRIGHTNESS_GREEN }
+             :                        Ledcolor { MIN_BRIGHTNESS_RED, 0 };
+    }
+
+    Ledcolor         _colors [SIZE];
+};
+
+
+#endif
@@ -0,0 +1,107 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+#include <time.h>
+#include <unistd.h>
+#include <string.h>
+#include <syscall.h>
+#include <linux/futex.h>
+#include "ledframe.h"
+
+
+#if !defined(SYS_futex) && defined(SYS_futex_time64)
+#define SYS_futex SYS_futex_time64
+#endif
+
+
+Ledmailbox::Ledmailbox (void)
+{
+    reset ();
+}
+
+
+Ledmailbox::~Ledmailbox (void)
+{
+}
+
+
+void Ledmailbox::reset (void)
+{
+    memset (_frames, 0, sizeof (_frames));
+    _wr = 0;
+    _rd = 1;
+    _mid = 2;
+    _seq = 0;
+    _closed = false;
+}
+
+
+void Ledmailbox::publish (void)
+{
+    // Called by the producer once write_frame() is completely filled.
+
+    _wr = __atomic_exchange_n (&_mid, _wr | FRESH, __ATOMIC_ACQ_REL) & INDEX;
+
+    __atomic_add_fetch (&_seq, 1, __ATOMIC_RELEASE);
+    syscall (SYS_futex, &_seq, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+
+void Ledmailbox::close (void)
+{
+    _closed = true;
+
+    __atomic_add_fetch (&_seq, 1, __ATOMIC_RELEASE);
+    syscall (SYS_futex, &_seq, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+
+const Ledframe *Ledmailbox::read (int timeout)
+{
+    struct timespec ts;
+    int             seq;
+
+    for (;;)
+    {
+        seq = __atomic_load_n (&_seq, __ATOMIC_ACQUIRE);
+
+        if (_closed) return NULL;
+
+        if (__atomic_load_n (&_mid, __ATOMIC_ACQUIRE) & FRESH)
+        {
+            _rd = __atomic_exchange_n (&_mid, _rd, __ATOMIC_ACQ_REL) & INDEX;
+            return _frames + _rd;
+        }
+
+        // nothing new, sleep until the producer bumps the sequence
+        if (timeout < 0)
+        {
+            syscall (SYS_futex, &_seq, FUTEX_WAIT, seq, nullptr, nullptr, 0);
+            continue;
+        }
+
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        syscall (SYS_futex, &_seq, FUTEX_WAIT, seq, &ts, nullptr, 0);
+        timeout = 0;
+
+        if (__atomic_load_n (&_seq, __ATOMIC_ACQUIRE) == seq) return _frames + _rd;
+    }
+}
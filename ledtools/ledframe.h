@@ -0,0 +1,84 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+#ifndef __LEDFRAME_H
+#define __LEDFRAME_H
+
+
+#include <stdint.h>
+
+
+// Target PWM value (LEDn_OFF) for every channel of every PCA9685,
+// chips are indexed in Ledlayout order.
+// Channels flagged urgent (one bit per channel) go out ahead of the
+// others when bus time is limited, e.g. clip indicator transitions.
+// A frame with sleep set is dark and puts the chips in low power mode
+// until a frame without it arrives.
+
+struct Ledframe
+{
+    enum { NCHAN = 16, MAXCHIP = 8 };
+
+    uint16_t pwm [MAXCHIP][NCHAN];
+    uint16_t urgent [MAXCHIP];
+    bool     sleep;
+};
+
+
+// Single-producer / single-consumer "latest wins" mailbox.
+// The producer always has a private frame to fill, publishing it swaps it
+// with the shared middle slot, so a consumer that is slower than the
+// producer only ever sees the newest frame and stale ones are dropped.
+
+class Ledmailbox
+{
+public:
+
+    Ledmailbox (void);
+    ~Ledmailbox (void);
+
+    // not thread-safe, call before starting producer and consumer
+    void reset (void);
+
+    // producer side
+    Ledframe *write_frame (void) { return _frames + _wr; }
+    void publish (void);
+    void close (void);
+
+    // consumer side, blocks until a new frame is available or
+    // the mailbox is closed, in which case NULL is returned;
+    // with a timeout (ms) the previous frame is returned again
+    // if nothing new arrived in time
+    const Ledframe *read (int timeout = -1);
+
+private:
+
+    enum { FRESH = 4, INDEX = 3 };
+
+    Ledframe         _frames [3];
+    int              _wr;      // slot owned by producer
+    int              _rd;      // slot owned by consumer
+    int              _mid;     // shared slot index, plus FRESH flag
+    int              _seq;     // futex word, bumped on every publish
+    volatile bool    _closed;
+};
+
+
+#endif
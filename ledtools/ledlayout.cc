@@ -0,0 +1,148 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pca9685.h"
+#include "ledlayout.h"
+
+
+static const LED_ID colorIdMap [4] = {
+    kLedIn1,
+    kLedIn2,
+    kLedOut1,
+    kLedOut2,
+};
+
+
+Ledlayout::Ledlayout (void)
+{
+    clear ();
+}
+
+
+Ledlayout::~Ledlayout (void)
+{
+}
+
+
+void Ledlayout::clear (void)
+{
+    _nbus = 0;
+    _nchip = 0;
+    _nmeter = 0;
+}
+
+
+void Ledlayout::set_default (int bus_number)
+{
+    // The MOD units: in 1/2 and out 1/2 on a single chip.
+
+    clear ();
+    for (int i = 0; i < 4; i++)
+    {
+        add_meter (bus_number, PCA9685_ADDR,
+                   channel (colorIdMap [i], kLedColorRed),
+                   channel (colorIdMap [i], kLedColorGreen));
+    }
+}
+
+
+int Ledlayout::parse (const char *spec)
+{
+    // Returns 0 on success, -1 if the spec is invalid or too big,
+    // in which case the layout is left empty.
+
+    long  v [4];
+    char  *end;
+    int   i;
+
+    clear ();
+    while (*spec)
+    {
+        if (*spec == ',' || *spec == ' ' || *spec == '\t')
+        {
+            spec++;
+            continue;
+        }
+        for (i = 0; i < 4; i++)
+        {
+            v [i] = strtol (spec, &end, 0);
+            if (end == spec || (i < 3 && *end != ':')) break;
+            spec = (i < 3) ? end + 1 : end;
+        }
+        if (i < 4 || add_meter (v [0], v [1], v [2], v [3]))
+        {
+            printf ("mod-peakmeter: invalid LED layout entry %d\n", _nmeter + 1);
+            clear ();
+            return -1;
+        }
+    }
+    return _nmeter ? 0 : -1;
+}
+
+
+int Ledlayout::add_meter (int bus_number, int addr, int red, int green)
+{
+    int  b, c;
+
+    if (_nmeter == MAXMETER) return -1;
+    if (bus_number < 0 || addr < 0x03 || addr > 0x77) return -1;
+    if (red < 0 || red >= Ledframe::NCHAN || green < 0 || green >= Ledframe::NCHAN) return -1;
+
+    // every channel drives one LED part only
+    if (red == green) return -1;
+    for (int i = 0; i < _nmeter; i++)
+    {
+        const Meter& M = _meters [i];
+        const Chip&  C = _chips [M.chip];
+
+        if (C.addr != addr || _buses [C.bus].number != bus_number) continue;
+        if (M.red == red || M.red == green || M.green == red || M.green == green) return -1;
+    }
+
+    for (b = 0; b < _nbus && _buses [b].number != bus_number; b++);
+    if (b == _nbus)
+    {
+        if (_nbus == MAXBUS) return -1;
+        _buses [b].number = bus_number;
+        _buses [b].nchip = 0;
+        _nbus++;
+    }
+
+    for (c = 0; c < _nchip && (_chips [c].bus != b || _chips [c].addr != addr); c++);
+    if (c == _nchip)
+    {
+        if (_nchip == MAXCHIP) return -1;
+        _chips [c].bus = b;
+        _chips [c].addr = addr;
+        _buses [b].chips [_buses [b].nchip++] = c;
+        _nchip++;
+    }
+
+    _meters [_nmeter].chip = c;
+    _meters [_nmeter].red = red;
+    _meters [_nmeter].green = green;
+    _nmeter++;
+    return 0;
+}
@@ -0,0 +1,122 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __LEDLAYOUT_H
+#define __LEDLAYOUT_H
+
+
+#include <stdint.h>
+#include "ledframe.h"
+
+
+// Do not change these enums! They match how the hardware works.
+// Unless you're changing hardware, leave these alone.
+enum LED_ID {
+#ifndef _MOD_DEVICE_DWARF
+    // normal
+    kLedOut2,
+    kLedOut1,
+    kLedIn1,
+    kLedIn2
+#else
+    // inverted for dwarf
+    kLedOut1,
+    kLedOut2,
+    kLedIn2,
+    kLedIn1
+#endif
+};
+
+enum LED_Color {
+    kLedColorBlue,
+    kLedColorRed,
+    kLedColorGreen,
+    kLedColorOff
+};
+
+
+// Where every meter's LED lives: i2c bus, PCA9685 address and the
+// channels driving its red and green parts.
+//
+// A layout is either the built-in MOD one (4 meters on a single chip) or
+// parsed from a spec with one "bus:address:red:green" entry per meter,
+// separated by commas or spaces, e.g. "1:0x41:9:10, 1:0x41:13:14".
+// Buses and chips are numbered in order of first appearance. A channel
+// can only be used once on each chip.
+
+class Ledlayout
+{
+public:
+
+    enum { MAXBUS = 4, MAXCHIP = Ledframe::MAXCHIP, MAXMETER = 64 };
+
+    struct Bus
+    {
+        int      number;            // N in /dev/i2c-N
+        int      nchip;
+        int      chips [MAXCHIP];   // indices into chip table
+    };
+
+    struct Chip
+    {
+        int      bus;               // index into bus table
+        uint8_t  addr;
+    };
+
+    struct Meter
+    {
+        int      chip;              // index into chip table
+        uint8_t  red;
+        uint8_t  green;
+    };
+
+    Ledlayout (void);
+    ~Ledlayout (void);
+
+    void set_default (int bus_number);
+    int parse (const char *spec);
+
+    int nbus (void) const { return _nbus; }
+    int nchip (void) const { return _nchip; }
+    int nmeter (void) const { return _nmeter; }
+
+    const Bus& bus (int i) const { return _buses [i]; }
+    const Chip& chip (int i) const { return _chips [i]; }
+    const Meter& meter (int i) const { return _meters [i]; }
+
+    static int channel (LED_ID led_id, LED_Color led_color) { return led_id * 4 + led_color; }
+
+private:
+
+    void clear (void);
+    int add_meter (int bus_number, int addr, int red, int green);
+
+    int              _nbus;
+    int              _nchip;
+    int              _nmeter;
+    Bus              _buses [MAXBUS];
+    Chip             _chips [MAXCHIP];
+    Meter            _meters [MAXMETER];
+};
+
+
+#endif
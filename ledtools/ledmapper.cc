@@ -0,0 +1,152 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <math.h>
+#include <string.h>
+#include "ledcolortable.h"
+#include "ledmapper.h"
+
+
+static constexpr Ledcolortable <LED_COLOR_TABLE_SIZE, LED_COLOR_CURVE> colorTable;
+
+
+Ledmapper::Ledmapper (void) :
+    _layout (0)
+{
+    set_ballistics (LED_ATTACK_MS, LED_RELEASE_MS, LED_CLIP_ON_MS, LED_CLIP_OFF_MS);
+    reset ();
+}
+
+
+Ledmapper::~Ledmapper (void)
+{
+}
+
+
+void Ledmapper::setup (const Ledlayout *layout)
+{
+    _layout = layout;
+    reset ();
+}
+
+
+void Ledmapper::set_ballistics (float attack, float release, float clip_on, float clip_off)
+{
+    // attack   : smoothing time constant for rising levels, ms
+    // release  : smoothing time constant for falling levels, ms
+    // clip_on  : time the clip indicator stays bright, ms
+    // clip_off : time it stays dim before blinking again, ms
+
+    _attack = 1e-3f * fmaxf (attack, 0.1f);
+    _release = 1e-3f * fmaxf (release, 0.1f);
+    _clip_on = 1e-3f * fmaxf (clip_on, 1.0f);
+    _clip_off = 1e-3f * fmaxf (clip_off, 1.0f);
+}
+
+
+void Ledmapper::reset (void)
+{
+    memset (_clipping, 0, sizeof (_clipping));
+    memset (_cliptime, 0, sizeof (_cliptime));
+    memset (_filtered, 0, sizeof (_filtered));
+}
+
+
+bool Ledmapper::process (const float *pks, Ledframe *frame, float dt, const bool *clip)
+{
+    // Called by the meter thread once per frame.
+    //
+    // pks   : one peak value per layout meter, as returned by Jkmeter
+    // frame : receives the full target frame, unused channels are off
+    // dt    : time since the previous frame, seconds
+    // clip  : per meter clip state if known, else clipping is taken
+    //         from a peak near full scale
+    //
+    // Returns true while the frame would keep changing with constant
+    // input, i.e. a clip blink is running or smoothing has not settled.
+
+    float    value, tau;
+    bool     animating = false;
+
+    memset (frame->pwm, 0, sizeof (frame->pwm));
+    memset (frame->urgent, 0, sizeof (frame->urgent));
+
+    #define set_led_color(col, val) \
+        frame->pwm [meter.chip][col == kLedColorRed ? meter.red : meter.green] = val
+
+    #define set_led_urgent() \
+        frame->urgent [meter.chip] |= (1 << meter.red) | (1 << meter.green)
+
+    for (int i = 0; i < _layout->nmeter (); ++i)
+    {
+        const Ledlayout::Meter& meter = _layout->meter (i);
+
+        value = pks [i];
+
+        if (clip ? clip [i] : value > LED_LEVEL_CLIP) // clipping
+        {
+            // start a new blink cycle on the first clipping frame,
+            // which goes ahead of level changes
+            if (_clipping [i])
+            {
+                _cliptime [i] = fmodf (_cliptime [i] + dt, _clip_on + _clip_off);
+            }
+            else
+            {
+                _cliptime [i] = 0.0f;
+                set_led_urgent ();
+            }
+
+            _clipping [i] = true;
+            animating = true;
+
+            set_led_color (kLedColorRed, _cliptime [i] < _clip_on ? MAX_BRIGHTNESS_RED : MIN_BRIGHTNESS_RED);
+            set_led_color (kLedColorGreen, 0);
+        }
+        else // no clipping
+        {
+            // leaving clip is as urgent as entering it
+            if (_clipping [i])
+                set_led_urgent ();
+
+            _clipping [i] = false;
+
+            // one pole smoothing, exact for any frame time
+            tau = (value > _filtered [i]) ? _attack : _release;
+            value = _filtered [i] + (value - _filtered [i]) * (1.0f - expf (-dt / tau));
+
+            const Ledcolor& color = colorTable.lookup (fminf (fmaxf (value, 0.0f), 1.0f));
+            set_led_color (kLedColorRed, color.red);
+            set_led_color (kLedColorGreen, color.green);
+
+            if (fabsf (value - pks [i]) >= LED_LEVEL_STEP)
+                animating = true;
+
+            _filtered [i] = value;
+        }
+    }
+
+    #undef set_led_color
+    #undef set_led_urgent
+
+    return animating;
+}
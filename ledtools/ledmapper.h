@@ -0,0 +1,79 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __LEDMAPPER_H
+#define __LEDMAPPER_H
+
+
+#include "ledlayout.h"
+
+
+// level to colour table resolution and brightness curve
+#ifndef LED_COLOR_TABLE_SIZE
+#define LED_COLOR_TABLE_SIZE 1024
+#endif
+#ifndef LED_COLOR_CURVE
+#define LED_COLOR_CURVE kLedCurveCIE
+#endif
+
+// smallest level change that can make a visible difference
+#define LED_LEVEL_STEP (0.5f / (LED_COLOR_TABLE_SIZE - 1))
+
+// default ballistics, in ms, matching the original per-frame smoothing and clip blink at 40 Hz
+#define LED_ATTACK_MS   240.0f
+#define LED_RELEASE_MS  240.0f
+#define LED_CLIP_ON_MS  100.0f
+#define LED_CLIP_OFF_MS 125.0f
+
+
+// Turns meter levels into a complete LED frame.
+// Keeps the per-meter smoothing and clip blink state, but does no I/O,
+// so it can be driven without any hardware present.
+// Smoothing and blink are integrated over the real time between frames,
+// so they look the same whatever the frame rate.
+
+class Ledmapper
+{
+public:
+
+    Ledmapper (void);
+    ~Ledmapper (void);
+
+    void setup (const Ledlayout *layout);
+    void set_ballistics (float attack, float release, float clip_on, float clip_off);
+    void reset (void);
+    bool process (const float *pks, Ledframe *frame, float dt, const bool *clip = 0);
+
+private:
+
+    const Ledlayout *_layout;
+    float            _attack;                          // smoothing time constants, seconds
+    float            _release;
+    float            _clip_on;                         // clip blink bright and dim times, seconds
+    float            _clip_off;
+    bool             _clipping [Ledlayout::MAXMETER];  // clip blink running
+    float            _cliptime [Ledlayout::MAXMETER];  // time into clip blink cycle
+    float            _filtered [Ledlayout::MAXMETER];  // smoothed level
+};
+
+
+#endif
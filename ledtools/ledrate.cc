@@ -0,0 +1,112 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <string.h>
+#include "ledcolortable.h"
+#include "ledrate.h"
+
+
+// level rise between two frames that counts as a transient
+#define LED_TRANSIENT_RISE 0.1f
+
+// per frame factor for relaxing from the fast back to the normal interval
+#define LED_RELAX_FACTOR 1.5f
+
+
+Ledrate::Ledrate (void) :
+    _fast (10),
+    _normal (25),
+    _idle (250)
+{
+    reset ();
+}
+
+
+Ledrate::~Ledrate (void)
+{
+}
+
+
+void Ledrate::setup (int fast, int normal, int idle, int floor)
+{
+    // All intervals in ms, fast <= normal <= idle. Those below floor
+    // are raised to it.
+
+    _fast = (fast > floor) ? fast : floor;
+    _normal = (normal > floor) ? normal : floor;
+    _idle = (idle > floor) ? idle : floor;
+    reset ();
+}
+
+
+void Ledrate::reset (void)
+{
+    memset (_last, 0, sizeof (_last));
+    _interval = _normal;
+    _isidle = false;
+}
+
+
+int Ledrate::update (const float *pks, int nmeter, const Ledframe *frame)
+{
+    // Called by the meter thread after every frame.
+    //
+    // pks    : peak values the frame was made from
+    // nmeter : number of peak values
+    // frame  : the frame itself
+    //
+    // Returns the time until the next frame, in ms.
+
+    bool            silent = true, transient = false;
+    const uint16_t *p = frame->pwm [0];
+    int             i;
+
+    _isidle = false;
+
+    for (i = 0; i < nmeter; i++)
+    {
+        if (pks [i] >= LED_LEVEL_OFF) silent = false;
+        if (pks [i] - _last [i] > LED_TRANSIENT_RISE) transient = true;
+        _last [i] = pks [i];
+    }
+
+    if (transient)
+    {
+        _interval = _fast;
+    }
+    else if (silent)
+    {
+        for (i = 0; i < Ledframe::MAXCHIP * Ledframe::NCHAN && p [i] == 0; i++);
+        _isidle = (i == Ledframe::MAXCHIP * Ledframe::NCHAN);
+        _interval = _isidle ? _idle : _normal;
+    }
+    else if (_interval < _normal)
+    {
+        _interval *= LED_RELAX_FACTOR;
+        if (_interval > _normal) _interval = _normal;
+    }
+    else
+    {
+        _interval = _normal;
+    }
+
+    return (int)(_interval + 0.5f);
+}
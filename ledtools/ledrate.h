@@ -0,0 +1,60 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __LEDRATE_H
+#define __LEDRATE_H
+
+
+#include "ledmapper.h"
+
+
+// Picks the time until the next LED frame from signal activity.
+// Silent inputs with all LEDs dark drop to the idle interval, a rising
+// level jumps to the fast interval, which then relaxes back to the
+// normal one over a few frames. No interval is shorter than the floor,
+// the time the LED buses need for a frame.
+
+class Ledrate
+{
+public:
+
+    Ledrate (void);
+    ~Ledrate (void);
+
+    void setup (int fast, int normal, int idle, int floor = 0);
+    void reset (void);
+    int update (const float *pks, int nmeter, const Ledframe *frame);
+
+    // true if the last update found silence and all LEDs dark
+    bool idle (void) const { return _isidle; }
+
+private:
+
+    float            _last [Ledlayout::MAXMETER];  // levels at previous frame
+    float            _interval;                    // current interval, ms
+    int              _fast;
+    int              _normal;
+    int              _idle;
+    bool             _isidle;
+};
+
+
+#endif
@@ -0,0 +1,277 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ledscheduler.h"
+
+
+// good measurements wanted from calibrate(), and the tries allowed for them
+#define LED_CALIBRATE_SAMPLES 8
+#define LED_CALIBRATE_TRIES 24
+
+
+Ledscheduler::Ledscheduler (void) :
+    _msg_us (0),
+    _chan_us (0),
+    _budget_us (0)
+{
+    memset (_urgent, 0, sizeof (_urgent));
+}
+
+
+Ledscheduler::~Ledscheduler (void)
+{
+}
+
+
+void Ledscheduler::set_costs (float msg_us, float chan_us)
+{
+    // msg_us  : cost of a write message, on top of its channels
+    // chan_us : cost of every channel written
+
+    _msg_us = msg_us;
+    _chan_us = chan_us;
+}
+
+
+void Ledscheduler::set_budget (float budget_us)
+{
+    _budget_us = budget_us;
+}
+
+
+void Ledscheduler::estimate (LED_WriteMode mode, int clock)
+{
+    // Sets the cost model from the bus time alone, counted the same way
+    // as Pca9685emu does: 9 bits per byte, a START per message and a
+    // STOP per transaction. Without syscall overhead this is a lower
+    // bound, but it needs no traffic at all.
+    //
+    // mode  : how frames are written
+    // clock : SCL frequency in Hz
+
+    const float bit_us = 1e6f / clock;
+
+    if (mode == kLedWriteByteData)
+    {
+        // two transactions of address, register and data per channel
+        set_costs (0, 2 * (3 * 9 + 2) * bit_us);
+    }
+    else
+    {
+        // address, register, then 4 bytes per channel less the last
+        // LEDn_ON pair, taking a STOP for every message at worst
+        set_costs (2 * bit_us, 4 * 9 * bit_us);
+    }
+}
+
+
+bool Ledscheduler::calibrate (I2Cbus *bus, LED_WriteMode mode, const Ledlayout *layout, int busidx, const Ledframe *held,
+                              double (*clock) (I2Cbus *bus), int *failed)
+{
+    // Measures the cost model on a bus by rewriting the values the
+    // chips already hold through the same commit path the frames take,
+    // first one channel on every chip then a run of
+    // PCA9685_MAX_CHANNELS_PER_WRITE on every chip. The fastest of a
+    // few good tries filters out scheduling noise.
+    //
+    // bus, mode       : as passed to commit_led_frame()
+    // layout, busidx  : which chips to measure
+    // held            : what the chips currently hold
+    // clock           : running time on the bus in us
+    // failed          : receives the number of commits that failed,
+    //                   these may have left the chips partly written
+    //
+    // Returns false, leaving the costs unchanged, if nothing could be
+    // measured.
+
+    const Ledlayout::Bus& lbus = layout->bus (busidx);
+    Ledframe  fake;
+    double    t, one = 1e9, run = 1e9;
+    int       i, c, k, none = 0, nrun = 0;
+
+    *failed = 0;
+    for (i = 0; i < LED_CALIBRATE_TRIES && (none < LED_CALIBRATE_SAMPLES || nrun < LED_CALIBRATE_SAMPLES); i++)
+    {
+        memcpy (&fake, held, sizeof (fake));
+        for (k = 0; k < lbus.nchip; k++) fake.pwm [lbus.chips [k]][0] ^= 1;
+        t = clock (bus);
+        if (commit_led_frame (bus, mode, layout, busidx, held, &fake))
+        {
+            if ((t = (clock (bus) - t) / lbus.nchip) < one) one = t;
+            none++;
+        }
+        else
+        {
+            (*failed)++;
+            continue;
+        }
+
+        for (k = 0; k < lbus.nchip; k++)
+        {
+            for (c = 0; c < PCA9685_MAX_CHANNELS_PER_WRITE; c++) fake.pwm [lbus.chips [k]][c] ^= 1;
+        }
+        t = clock (bus);
+        if (commit_led_frame (bus, mode, layout, busidx, held, &fake))
+        {
+            if ((t = (clock (bus) - t) / lbus.nchip) < run) run = t;
+            nrun++;
+        }
+        else (*failed)++;
+    }
+
+    if (!none || !nrun) return false;
+
+    const double chan = (run - one) / (PCA9685_MAX_CHANNELS_PER_WRITE - 1);
+    set_costs (one > chan ? one - chan : 0, chan > 0 ? chan : 0);
+    return true;
+}
+
+
+bool Ledscheduler::select (const Ledlayout *layout, int busidx, const Ledframe *target, const Ledframe *current, Ledframe *next)
+{
+    // Called by the writer thread before committing a frame.
+    //
+    // layout, busidx  : which chips to look at
+    // target          : the frame to show
+    // current         : what the chips currently hold
+    // next            : receives current, with the selected target values
+    //
+    // Returns true if some changes had to be deferred.
+
+    const Ledlayout::Bus& lbus = layout->bus (busidx);
+    uint16_t  sel [Ledframe::MAXCHIP];
+    float     cost;
+    int       i, k, n, c, chip;
+    bool      deferred = false;
+
+    memcpy (next, current, sizeof (Ledframe));
+    if (_budget_us <= 0)
+    {
+        for (k = 0; k < lbus.nchip; k++)
+        {
+            chip = lbus.chips [k];
+            memcpy (next->pwm [chip], target->pwm [chip], sizeof (next->pwm [chip]));
+            _urgent [chip] = 0;
+        }
+        return false;
+    }
+
+    // Collect changed channels with their visible error. Urgent ones
+    // that were deferred before stay urgent until they are written.
+    for (k = n = 0; k < lbus.nchip; k++)
+    {
+        chip = lbus.chips [k];
+        _urgent [chip] |= target->urgent [chip];
+        for (c = 0; c < Ledframe::NCHAN; c++)
+        {
+            if (target->pwm [chip][c] == current->pwm [chip][c])
+            {
+                _urgent [chip] &= ~(1 << c);
+                continue;
+            }
+            _items [n].chip = chip;
+            _items [n].chan = c;
+            _items [n].urgent = (_urgent [chip] >> c) & 1;
+            _items [n].error = fabsf (lightness (target->pwm [chip][c]) - lightness (current->pwm [chip][c]));
+            n++;
+        }
+    }
+    qsort (_items, n, sizeof (Item), compare);
+
+    // Take them in order while within budget, urgent ones first but
+    // charged like any other, so the budget is a hard limit. The first
+    // one is always taken, so a budget too small for a single write
+    // still lets the most visible change through.
+    // A channel next to one already taken extends the same write message.
+    memset (sel, 0, sizeof (sel));
+    for (i = 0, cost = 0; i < n; i++)
+    {
+        const Item& it = _items [i];
+        const float add = _chan_us + ((sel [it.chip] & (((1 << it.chan) << 1) | ((1 << it.chan) >> 1))) ? 0 : _msg_us);
+
+        if (i && cost + add > _budget_us)
+        {
+            deferred = true;
+            continue;
+        }
+        cost += add;
+        sel [it.chip] |= 1 << it.chan;
+        _urgent [it.chip] &= ~(1 << it.chan);
+        next->pwm [it.chip][it.chan] = target->pwm [it.chip][it.chan];
+    }
+
+    return deferred;
+}
+
+
+float Ledscheduler::frame_cost (const Ledlayout *layout, int busidx) const
+{
+    // Estimated bus time in us for changing every channel the layout
+    // uses on the bus, the most a frame can take without a budget.
+    // Adjacent channels share a write, up to the longest one sent.
+
+    const Ledlayout::Bus& lbus = layout->bus (busidx);
+    float     cost = 0;
+    unsigned  used;
+    int       i, k, c, n;
+
+    for (k = 0; k < lbus.nchip; k++)
+    {
+        used = 0;
+        for (i = 0; i < layout->nmeter (); i++)
+        {
+            const Ledlayout::Meter& M = layout->meter (i);
+
+            if (M.chip == lbus.chips [k]) used |= (1u << M.red) | (1u << M.green);
+        }
+        for (c = 0; c < Ledframe::NCHAN; c += n)
+        {
+            for (n = 0; c + n < Ledframe::NCHAN && (used >> (c + n) & 1) && n < PCA9685_MAX_CHANNELS_PER_WRITE; n++);
+            if (n) cost += _msg_us + n * _chan_us;
+            else n = 1;
+        }
+    }
+    return cost;
+}
+
+
+float Ledscheduler::lightness (uint16_t pwm)
+{
+    // CIE 1931 lightness L* (0..100) of a 12 bit PWM duty cycle.
+
+    const float y = pwm / 4095.0f;
+
+    return (y <= 0.008856f) ? 903.3f * y : 116.0f * cbrtf (y) - 16.0f;
+}
+
+
+int Ledscheduler::compare (const void *a, const void *b)
+{
+    const Item *x = (const Item *) a;
+    const Item *y = (const Item *) b;
+
+    if (x->urgent != y->urgent) return y->urgent - x->urgent;
+    if (x->error != y->error) return (y->error > x->error) ? 1 : -1;
+    return 0;
+}
@@ -0,0 +1,82 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __LEDSCHEDULER_H
+#define __LEDSCHEDULER_H
+
+
+#include "pca9685.h"
+
+
+// Keeps the bus time spent on each LED frame within a budget.
+// Changed channels are ranked by how visible their change is (CIE
+// lightness difference), urgent ones first, and written in that order
+// until the estimated cost reaches the budget; the rest is deferred to
+// a later frame, urgent ones staying ahead until they are written.
+// The first change of a frame is always taken, whatever the budget.
+// The cost model is a fixed cost per write message plus a cost per
+// channel, as measured on the bus by calibrate(), or else estimated
+// from the bits a write puts on the wire.
+
+class Ledscheduler
+{
+public:
+
+    Ledscheduler (void);
+    ~Ledscheduler (void);
+
+    void set_costs (float msg_us, float chan_us);
+    void set_budget (float budget_us);
+    void estimate (LED_WriteMode mode, int clock);
+    bool calibrate (I2Cbus *bus, LED_WriteMode mode, const Ledlayout *layout, int busidx, const Ledframe *held,
+                    double (*clock) (I2Cbus *bus), int *failed);
+
+    float msg_cost (void) const { return _msg_us; }
+    float chan_cost (void) const { return _chan_us; }
+    float budget (void) const { return _budget_us; }
+    float min_budget (void) const { return _msg_us + _chan_us; }
+
+    bool select (const Ledlayout *layout, int busidx, const Ledframe *target, const Ledframe *current, Ledframe *next);
+    float frame_cost (const Ledlayout *layout, int busidx) const;
+
+    static float lightness (uint16_t pwm);
+
+private:
+
+    struct Item
+    {
+        uint8_t  chip;
+        uint8_t  chan;
+        uint8_t  urgent;
+        float    error;
+    };
+
+    static int compare (const void *a, const void *b);
+
+    float            _msg_us;
+    float            _chan_us;
+    float            _budget_us;    // 0 for no limit
+    uint16_t         _urgent [Ledframe::MAXCHIP];  // urgent channels not written yet
+    Item             _items [Ledframe::MAXCHIP * Ledframe::NCHAN];
+};
+
+
+#endif
@@ -0,0 +1,330 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "ledwriter.h"
+
+
+// immediate retries of a frame that failed to go out
+#define LED_RETRY_MAX 2
+
+// frames failed in a row before the chips are set up again
+#define LED_REINIT_FAILURES 8
+
+// longest wait between tries on a failing bus, in ms
+#define LED_BACKOFF_MAX 1000
+
+// SCL frequency taken for the bus time of a frame when it is not measured
+#define LED_BUS_CLOCK 100000
+
+
+Ledwriter::Ledwriter (void) :
+    _bus (0),
+    _layout (0),
+    _busidx (0),
+    _inverted (false),
+    _mode (kLedWriteByteData),
+    _running (false),
+    _budget (0),
+    _interval (25),
+    _asleep (false),
+    _errors (0),
+    _failures (0),
+    _backoff (0)
+{
+}
+
+
+Ledwriter::~Ledwriter (void)
+{
+    stop ();
+}
+
+
+void Ledwriter::set_budget (int budget_us, int interval_ms)
+{
+    // budget_us   : bus time allowed per frame, 0 for no limit
+    // interval_ms : how soon to retry changes that did not fit
+    //
+    // Takes effect on the next start(), which raises a budget that
+    // does not fit a single write on the bus.
+
+    _budget = budget_us > 0 ? budget_us : 0;
+    _interval = interval_ms > 0 ? interval_ms : 1;
+}
+
+
+int Ledwriter::start (I2Cbus *bus, const Ledlayout *layout, int busidx, bool inverted)
+{
+    // bus      : opened bus, all chips on it already initialised with
+    //            init_led_chip()
+    // layout   : LED layout, must stay valid until stop()
+    // busidx   : which of the layout buses this writer handles
+    // inverted : output polarity, for setting the chips up again
+
+    if (_running) return -1;
+
+    _bus = bus;
+    _layout = layout;
+    _busidx = busidx;
+    _inverted = inverted;
+    _mode = led_write_mode (bus);
+    memset (&_cache, 0, sizeof (_cache));
+    _mailbox.reset ();
+    _asleep = false;
+    __atomic_store_n (&_errors, 0, __ATOMIC_RELAXED);
+    _failures = 0;
+    _backoff = 0;
+    _scheduler.set_budget (_budget);
+
+    // measuring takes a few dozen commits, only worth it for a budget
+    if (_budget) calibrate ();
+    else _scheduler.estimate (_mode, LED_BUS_CLOCK);
+
+    // a budget must leave room for at least one write
+    if (_budget && _budget < _scheduler.min_budget ())
+    {
+        printf ("ledwriter: bus %d budget of %d us is below the %.0f us a single LED write takes, raising it\n",
+                layout->bus (busidx).number, _budget, ceilf (_scheduler.min_budget ()));
+        _budget = (int) ceilf (_scheduler.min_budget ());
+        _scheduler.set_budget (_budget);
+    }
+
+    if (pthread_create (&_thread, NULL, static_run, this)) return -1;
+    _running = true;
+    return 0;
+}
+
+
+int Ledwriter::min_interval (void) const
+{
+    // Shortest time between frames in ms that the bus keeps up with:
+    // the budget, or without one the time for a frame changing every
+    // LED on the bus. Valid once started.
+
+    float us = _scheduler.frame_cost (_layout, _busidx);
+
+    if (_budget > 0 && _budget < us) us = _budget;
+    return (int) ceilf (us * 1e-3f);
+}
+
+
+void Ledwriter::stop (void)
+{
+    if (!_running) return;
+
+    _mailbox.close ();
+    pthread_join (_thread, NULL);
+    _running = false;
+}
+
+
+void *Ledwriter::static_run (void *arg)
+{
+    ((Ledwriter *) arg)->run ();
+    return NULL;
+}
+
+
+static double elapsed_us (const timespec& t0, const timespec& t1)
+{
+    return (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) * 1e-3;
+}
+
+
+void Ledwriter::run (void)
+{
+    const Ledframe *frame;
+    timespec        retry, now;
+    bool            deferred = false;
+    int             timeout = -1;
+
+    // With a budget, changes that did not fit are retried after the
+    // frame interval even if no new frame arrives in between. On a
+    // failing bus new frames are only taken once the backoff expires.
+    while ((frame = _mailbox.read (timeout)) != NULL)
+    {
+        if (_backoff)
+        {
+            clock_gettime (CLOCK_MONOTONIC, &now);
+            timeout = (int) ceil (elapsed_us (now, retry) * 1e-3);
+            if (timeout > 0) continue;
+        }
+
+        if (write (frame, &deferred))
+        {
+            if (_failures >= LED_REINIT_FAILURES)
+            {
+                printf ("ledwriter: bus %d recovered after %d failed frames, %lu failed transactions so far\n",
+                        _layout->bus (_busidx).number, _failures, errors ());
+            }
+            _failures = 0;
+            _backoff = 0;
+        }
+        else
+        {
+            fault ();
+            clock_gettime (CLOCK_MONOTONIC, &retry);
+            retry.tv_sec += _backoff / 1000;
+            retry.tv_nsec += (_backoff % 1000) * 1000000;
+            if (retry.tv_nsec >= 1000000000)
+            {
+                retry.tv_sec += 1;
+                retry.tv_nsec -= 1000000000;
+            }
+        }
+
+        timeout = _backoff ? _backoff : (deferred ? _interval : -1);
+    }
+}
+
+
+bool Ledwriter::write (const Ledframe *frame, bool *deferred)
+{
+    *deferred = false;
+
+    if (frame->sleep)
+    {
+        // darken everything regardless of budget, then stop the oscillators
+        if (!_asleep)
+        {
+            if (!commit (frame)) return false;
+            if (!sleep_led_chips (_bus, _layout, _busidx, true)) return false;
+            _asleep = true;
+        }
+        return true;
+    }
+
+    if (_asleep)
+    {
+        if (!sleep_led_chips (_bus, _layout, _busidx, false)) return false;
+        _asleep = false;
+    }
+
+    if (_budget)
+    {
+        *deferred = _scheduler.select (_layout, _busidx, frame, &_cache, &_next);
+        return commit (&_next);
+    }
+    return commit (frame);
+}
+
+
+bool Ledwriter::commit (const Ledframe *frame)
+{
+    for (int i = 0; ; i++)
+    {
+        if (commit_led_frame (_bus, _mode, _layout, _busidx, frame, &_cache)) return true;
+
+        // a failed transaction may have been partly applied
+        __atomic_add_fetch (&_errors, 1, __ATOMIC_RELAXED);
+        invalidate ();
+        if (i == LED_RETRY_MAX) return false;
+    }
+}
+
+
+void Ledwriter::invalidate (void)
+{
+    // Marks every channel on the bus as unknown, no PWM value matches
+    // 0xFFFF, so all of them are written again by the next commit.
+
+    const Ledlayout::Bus& lbus = _layout->bus (_busidx);
+
+    for (int k = 0; k < lbus.nchip; k++)
+    {
+        memset (_cache.pwm [lbus.chips [k]], 0xFF, sizeof (_cache.pwm [0]));
+    }
+}
+
+
+void Ledwriter::fault (void)
+{
+    _failures++;
+    _backoff = _backoff ? 2 * _backoff : _interval;
+    if (_backoff > LED_BACKOFF_MAX) _backoff = LED_BACKOFF_MAX;
+
+    // a chip that lost power or got reset needs its setup again
+    if (_failures % LED_REINIT_FAILURES == 0)
+    {
+        printf ("ledwriter: bus %d failed %d frames in a row, %lu failed transactions so far, setting up chips again\n",
+                _layout->bus (_busidx).number, _failures, errors ());
+        reinit ();
+    }
+}
+
+
+void Ledwriter::reinit (void)
+{
+    const Ledlayout::Bus& lbus = _layout->bus (_busidx);
+    bool                  warm;
+
+    for (int k = 0; k < lbus.nchip; k++)
+    {
+        const int chip = lbus.chips [k];
+
+        if (!init_led_chip (_bus, _layout->chip (chip).addr, _inverted, &warm))
+        {
+            __atomic_add_fetch (&_errors, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        memset (_cache.pwm [chip], 0, sizeof (_cache.pwm [0]));
+    }
+    _asleep = false;
+}
+
+
+static double monotonic_us (I2Cbus *)
+{
+    timespec  t;
+
+    clock_gettime (CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e6 + t.tv_nsec * 1e-3;
+}
+
+
+void Ledwriter::calibrate (void)
+{
+    // Measures the scheduler cost model on this bus. Tries that fail
+    // are counted as errors, and as they may leave the chips partly
+    // written the cache is invalidated so the first frame puts
+    // everything back.
+
+    int  failed;
+    bool ok;
+
+    ok = _scheduler.calibrate (_bus, _mode, _layout, _busidx, &_cache, monotonic_us, &failed);
+    if (failed)
+    {
+        __atomic_add_fetch (&_errors, failed, __ATOMIC_RELAXED);
+        invalidate ();
+    }
+
+    if (!ok)
+    {
+        printf ("ledwriter: bus %d could not be calibrated, %lu failed transactions, estimating bus time instead\n",
+                _layout->bus (_busidx).number, errors ());
+        _scheduler.estimate (_mode, LED_BUS_CLOCK);
+    }
+}
@@ -0,0 +1,86 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __LEDWRITER_H
+#define __LEDWRITER_H
+
+
+#include <pthread.h>
+#include "pca9685.h"
+#include "ledscheduler.h"
+
+
+// Owns one i2c bus of a Ledlayout and a thread draining its mailbox
+// to the chips on it, so each bus is written to in parallel and a slow
+// transaction never delays metering.
+// A frame that fails to go out is retried a couple of times, then the
+// writer backs off, dropping to an ever lower frame rate while the bus
+// keeps failing, and re-initialises the chips now and then until the
+// bus recovers.
+
+class Ledwriter
+{
+public:
+
+    Ledwriter (void);
+    ~Ledwriter (void);
+
+    void set_budget (int budget_us, int interval_ms);
+    int start (I2Cbus *bus, const Ledlayout *layout, int busidx, bool inverted);
+    void stop (void);
+
+    Ledmailbox *mailbox (void) { return &_mailbox; }
+    const Ledscheduler *scheduler (void) const { return &_scheduler; }
+    int min_interval (void) const;
+    unsigned long errors (void) const { return __atomic_load_n (&_errors, __ATOMIC_RELAXED); }
+
+private:
+
+    static void *static_run (void *arg);
+    void run (void);
+    bool write (const Ledframe *frame, bool *deferred);
+    bool commit (const Ledframe *frame);
+    void invalidate (void);
+    void fault (void);
+    void reinit (void);
+    void calibrate (void);
+
+    I2Cbus          *_bus;
+    const Ledlayout *_layout;
+    int              _busidx;
+    bool             _inverted;
+    LED_WriteMode    _mode;
+    bool             _running;
+    pthread_t        _thread;
+    Ledmailbox       _mailbox;
+    Ledframe         _cache;    // what the chips currently hold
+    Ledframe         _next;     // what the scheduler lets through
+    Ledscheduler     _scheduler;
+    int              _budget;   // bus time per frame in us, 0 for no limit
+    int              _interval; // retry time for deferred changes in ms
+    bool             _asleep;   // chips in low power mode
+    unsigned long    _errors;   // failed transactions since start(), written by the thread
+    int              _failures; // frames failed in a row
+    int              _backoff;  // ms to wait before the next try, 0 when healthy
+};
+
+
+#endif
@@ -0,0 +1,276 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <string.h>
+#include <time.h>
+#include "pca9685.h"
+
+
+LED_WriteMode led_write_mode(I2Cbus* const bus)
+{
+    const unsigned long funcs = bus->functionality();
+
+    if (funcs & I2C_FUNC_I2C)
+        return kLedWriteRdWr;
+    if (funcs & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)
+        return kLedWriteI2CBlock;
+    return kLedWriteByteData;
+}
+
+static long elapsed_us(const struct timespec& since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - since.tv_sec) * 1000000L + (now.tv_nsec - since.tv_nsec) / 1000L;
+}
+
+// sets every LED register to 0 through ALL_LED, as a single block write when possible
+static bool clear_all_leds(I2Cbus* const bus)
+{
+    static const uint8_t zeros[4] = { 0, 0, 0, 0 };
+
+    if (bus->functionality() & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)
+        return bus->write_i2c_block_data(PCA9685_ALL_LED_ON_L, 4, zeros) >= 0;
+
+    return (bus->write_byte_data(PCA9685_ALL_LED_ON_L,  0) >= 0 &&
+            bus->write_byte_data(PCA9685_ALL_LED_ON_H,  0) >= 0 &&
+            bus->write_byte_data(PCA9685_ALL_LED_OFF_L, 0) >= 0 &&
+            bus->write_byte_data(PCA9685_ALL_LED_OFF_H, 0) >= 0);
+}
+
+/* Leaves the chip at `addr` running with auto-increment enabled and every LED register at 0, which is the state
+ * commit_led_frame expects. The prescaler is left as it is, the power-on default unless set on purpose.
+ * A chip left configured by a previous instance only needs its LEDs cleared, `warm` tells if that was the case.
+ * Otherwise the chip is set up and woken, clearing the LEDs while the oscillator starts up. */
+bool init_led_chip(I2Cbus* const bus, const uint8_t addr, const bool inverted, bool* const warm)
+{
+    const uint8_t mode1 = PCA9685_ALLCALL|PCA9685_AI;
+    const uint8_t mode2 = inverted ? (PCA9685_INVRT|PCA9685_OUTDRV) : PCA9685_OUTDRV;
+
+    *warm = false;
+
+    if (bus->set_address(addr) < 0)
+        return false;
+
+    const int cur_mode1 = bus->read_byte_data(PCA9685_MODE1);
+    const int cur_mode2 = bus->read_byte_data(PCA9685_MODE2);
+
+    if (cur_mode1 < 0 || cur_mode2 < 0)
+        return false;
+
+    if ((cur_mode1 & ~PCA9685_RESTART) == mode1 && cur_mode2 == mode2)
+    {
+        *warm = true;
+        return clear_all_leds(bus);
+    }
+
+    if (cur_mode2 != mode2 && bus->write_byte_data(PCA9685_MODE2, mode2) < 0)
+        return false;
+
+    // wake up (reset sleep)
+    struct timespec woken;
+    clock_gettime(CLOCK_MONOTONIC, &woken);
+
+    if (bus->write_byte_data(PCA9685_MODE1, mode1) < 0)
+        return false;
+
+    if (! clear_all_leds(bus))
+        return false;
+
+    // wait for the oscillator, usually mostly done by the time the LEDs are cleared
+    const long remaining = PCA9685_OSC_STARTUP_US - elapsed_us(woken);
+
+    if (remaining > 0)
+    {
+        const struct timespec pause = { 0, remaining * 1000 };
+        nanosleep(&pause, nullptr);
+    }
+
+    return true;
+}
+
+/* Puts all chips on bus `busidx` in low power mode, or wakes them up again.
+ * LED registers are kept while sleeping, on wake up the PWM outputs are restarted with them once the oscillator is
+ * running, so the chips show what they did before without rewriting anything. */
+bool sleep_led_chips(I2Cbus* const bus, const Ledlayout* const layout, const int busidx, const bool sleep)
+{
+    const Ledlayout::Bus& lbus(layout->bus(busidx));
+    const uint8_t mode1 = PCA9685_ALLCALL|PCA9685_AI;
+
+    for (int k=0; k<lbus.nchip; ++k)
+    {
+        const uint8_t addr = layout->chip(lbus.chips[k]).addr;
+
+        if (bus->address() != addr && bus->set_address(addr) < 0)
+            return false;
+        if (bus->write_byte_data(PCA9685_MODE1, sleep ? (mode1|PCA9685_SLEEP) : mode1) < 0)
+            return false;
+    }
+
+    if (sleep)
+        return true;
+
+    // all oscillators start together, wait for them once
+    const struct timespec pause = { 0, PCA9685_OSC_STARTUP_US * 1000 };
+    nanosleep(&pause, nullptr);
+
+    for (int k=0; k<lbus.nchip; ++k)
+    {
+        const uint8_t addr = layout->chip(lbus.chips[k]).addr;
+
+        if (bus->address() != addr && bus->set_address(addr) < 0)
+            return false;
+        if (bus->write_byte_data(PCA9685_MODE1, mode1|PCA9685_RESTART) < 0)
+            return false;
+    }
+
+    return true;
+}
+
+// one multi-byte write, starting at LEDn_OFF_L of the first channel
+struct LED_Write {
+    uint8_t chip, first, count;
+    uint8_t buf[2 + PCA9685_MAX_CHANNELS_PER_WRITE*4 - 1];
+};
+
+static bool flush_led_writes(I2Cbus* const bus, const LED_WriteMode mode,
+                             const LED_Write* const writes, struct i2c_msg* const msgs, const int nmsgs,
+                             const Ledframe* const target, Ledframe* const current)
+{
+    if (mode == kLedWriteRdWr)
+    {
+        if (bus->transfer(msgs, nmsgs) < 0)
+            return false;
+    }
+
+    for (int i=0; i<nmsgs; ++i)
+    {
+        const LED_Write& w(writes[i]);
+
+        if (mode == kLedWriteI2CBlock)
+        {
+            if (bus->address() != msgs[i].addr && bus->set_address(msgs[i].addr) < 0)
+                return false;
+            if (bus->write_i2c_block_data(w.buf[0], msgs[i].len - 1, w.buf + 1) < 0)
+                return false;
+        }
+
+        memcpy(current->pwm[w.chip] + w.first, target->pwm[w.chip] + w.first, sizeof(uint16_t)*w.count);
+    }
+
+    return true;
+}
+
+/* Writes every channel of the chips on bus `busidx` whose `target` value differs from `current`, then updates
+ * `current` with what was written.
+ * Requires MODE1 auto-increment, runs of adjacent changed channels are sent as a single multi-byte write starting at
+ * the first LEDn_OFF_L, rewriting the in-between LEDn_ON_L/H registers with 0 (which is what they always hold).
+ * In I2C_RDWR mode the writes for all chips on the bus go out in a single transaction. */
+bool commit_led_frame(I2Cbus* const bus, const LED_WriteMode mode, const Ledlayout* const layout, const int busidx,
+                      const Ledframe* const target, Ledframe* const current)
+{
+    const Ledlayout::Bus& lbus(layout->bus(busidx));
+
+    if (mode == kLedWriteByteData)
+    {
+        for (int k=0; k<lbus.nchip; ++k)
+        {
+            const int chip = lbus.chips[k];
+            const uint8_t addr = layout->chip(chip).addr;
+            const uint16_t* const frame = target->pwm[chip];
+            /* */ uint16_t* const cache = current->pwm[chip];
+
+            for (uint8_t c=0; c<PCA9685_NUM_CHANNELS; ++c)
+            {
+                if (frame[c] == cache[c])
+                    continue;
+
+                if (bus->address() != addr && bus->set_address(addr) < 0)
+                    return false;
+
+                if (bus->write_byte_data(PCA9685_LED0_OFF_L + c*4, frame[c] & 0xFF) < 0 ||
+                    bus->write_byte_data(PCA9685_LED0_OFF_H + c*4, frame[c] >> 8)   < 0)
+                    return false;
+
+                cache[c] = frame[c];
+            }
+        }
+        return true;
+    }
+
+    LED_Write writes[PCA9685_MAX_MSGS_PER_TRANSFER];
+    struct i2c_msg msgs[PCA9685_MAX_MSGS_PER_TRANSFER];
+    int nmsgs = 0;
+
+    for (int k=0; k<lbus.nchip; ++k)
+    {
+        const int chip = lbus.chips[k];
+        const uint16_t* const frame = target->pwm[chip];
+        const uint16_t* const cache = current->pwm[chip];
+
+        for (uint8_t c=0; c<PCA9685_NUM_CHANNELS; ++c)
+        {
+            if (frame[c] == cache[c])
+                continue;
+
+            if (nmsgs == PCA9685_MAX_MSGS_PER_TRANSFER)
+            {
+                if (! flush_led_writes(bus, mode, writes, msgs, nmsgs, target, current))
+                    return false;
+                nmsgs = 0;
+            }
+
+            LED_Write& w(writes[nmsgs]);
+            uint8_t len = 0;
+
+            w.chip  = chip;
+            w.first = c;
+            w.count = 0;
+            w.buf[len++] = PCA9685_LED0_OFF_L + c*4;
+
+            for (;;)
+            {
+                w.buf[len++] = frame[c] & 0xFF;
+                w.buf[len++] = frame[c] >> 8;
+
+                if (++w.count == PCA9685_MAX_CHANNELS_PER_WRITE || c+1 == PCA9685_NUM_CHANNELS || frame[c+1] == cache[c+1])
+                    break;
+
+                w.buf[len++] = 0;
+                w.buf[len++] = 0;
+                ++c;
+            }
+
+            msgs[nmsgs].addr  = layout->chip(chip).addr;
+            msgs[nmsgs].flags = 0;
+            msgs[nmsgs].len   = len;
+            msgs[nmsgs].buf   = (char*)w.buf;
+            ++nmsgs;
+        }
+    }
+
+    if (nmsgs == 0)
+        return true;
+
+    return flush_led_writes(bus, mode, writes, msgs, nmsgs, target, current);
+}
@@ -0,0 +1,92 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2016 Filipe Coelho <falktx@falktx.com>
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __PCA9685_H
+#define __PCA9685_H
+
+
+#include "i2cbus.h"
+#include "ledlayout.h"
+
+
+/* Register Addresses */
+#define PCA9685_MODE1         0x00
+#define PCA9685_MODE2         0x01
+#define PCA9685_LED0_ON_L     0x06
+#define PCA9685_LED0_ON_H     0x07
+#define PCA9685_LED0_OFF_L    0x08
+#define PCA9685_LED0_OFF_H    0x09
+#define PCA9685_ALL_LED_ON_L  0xFA
+#define PCA9685_ALL_LED_ON_H  0xFB
+#define PCA9685_ALL_LED_OFF_L 0xFC
+#define PCA9685_ALL_LED_OFF_H 0xFD
+#define PCA9685_PRESCALE      0xFE
+
+/* MODE1 Register */
+#define PCA9685_ALLCALL 0x01
+#define PCA9685_SLEEP   0x10
+#define PCA9685_AI      0x20
+#define PCA9685_RESTART 0x80
+
+/* MODE2 Register */
+#define PCA9685_OUTDRV  0x04
+#define PCA9685_INVRT   0x10
+
+/* PRESCALE Register, power-on value (200Hz) */
+#define PCA9685_PRESCALE_DEFAULT 0x1E
+
+/* Oscillator start-up time after clearing SLEEP, in microseconds */
+#define PCA9685_OSC_STARTUP_US 500
+
+/* Custom MOD */
+#define PCA9685_ADDR 0x41
+
+/* Number of PWM channels */
+#define PCA9685_NUM_CHANNELS 16
+
+/* Max channels packed into a single auto-increment write, keeps payload within I2C_SMBUS_I2C_BLOCK_MAX */
+#define PCA9685_MAX_CHANNELS_PER_WRITE 8
+
+/* Max messages in a single I2C_RDWR ioctl, I2C_RDWR_IOCTL_MAX_MSGS in the kernel */
+#define PCA9685_MAX_MSGS_PER_TRANSFER 42
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// how a frame is pushed to the bus, decided from the adapter functionality during init
+enum LED_WriteMode {
+    kLedWriteByteData,  // 2 single-byte writes per changed channel
+    kLedWriteI2CBlock,  // 1 auto-increment block write per run of changed channels
+    kLedWriteRdWr       // all runs of changed channels in a single I2C_RDWR transaction
+};
+
+LED_WriteMode led_write_mode(I2Cbus* bus);
+
+bool init_led_chip(I2Cbus* bus, uint8_t addr, bool inverted, bool* warm);
+
+bool sleep_led_chips(I2Cbus* bus, const Ledlayout* layout, int busidx, bool sleep);
+
+bool commit_led_frame(I2Cbus* bus, LED_WriteMode mode, const Ledlayout* layout, int busidx,
+                      const Ledframe* target, Ledframe* current);
+
+// --------------------------------------------------------------------------------------------------------------------
+
+#endif
@@ -0,0 +1,221 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <errno.h>
+#include <string.h>
+#include "pca9685.h"
+#include "pca9685emu.h"
+
+
+Pca9685emu::Pca9685emu (unsigned long funcs) :
+    _funcs (funcs),
+    _nchip (0)
+{
+    reset_stats ();
+}
+
+
+Pca9685emu::~Pca9685emu (void)
+{
+}
+
+
+int Pca9685emu::add_chip (int addr)
+{
+    if (_nchip == MAXCHIP || find (addr)) return -1;
+
+    Chip *C = _chips + _nchip++;
+
+    // power-on register values
+    C->addr = addr;
+    memset (C->regs, 0, sizeof (C->regs));
+    C->regs [PCA9685_MODE1] = PCA9685_SLEEP | PCA9685_ALLCALL;
+    C->regs [PCA9685_MODE2] = PCA9685_OUTDRV;
+    C->regs [PCA9685_PRESCALE] = PCA9685_PRESCALE_DEFAULT;
+    for (int i = 0; i < PCA9685_NUM_CHANNELS; i++)
+    {
+        C->regs [PCA9685_LED0_OFF_H + i * 4] = 0x10;  // full off
+    }
+    return 0;
+}
+
+
+Pca9685emu::Chip *Pca9685emu::find (int addr) const
+{
+    for (int i = 0; i < _nchip; i++)
+    {
+        if (_chips [i].addr == addr) return (Chip *)(_chips + i);
+    }
+    return 0;
+}
+
+
+int Pca9685emu::set_address (int addr)
+{
+    // Like i2c-dev, any address is accepted here, a missing chip only
+    // shows when it is accessed.
+
+    _addr = addr;
+    return 0;
+}
+
+
+int Pca9685emu::read_byte_data (uint8_t reg)
+{
+    if (!(_funcs & I2C_FUNC_SMBUS_READ_BYTE_DATA)) return -EOPNOTSUPP;
+
+    Chip *C = find (_addr);
+
+    // S addr reg Sr addr data P, or S addr NACK P
+    _stats.ioctls++;
+    if (!C)
+    {
+        account (1, 1);
+        return -EIO;
+    }
+    account (2, 3);
+
+    // ALL_LED registers always read back as zero
+    if (reg >= PCA9685_ALL_LED_ON_L && reg <= PCA9685_ALL_LED_OFF_H) return 0;
+    return C->regs [reg];
+}
+
+
+int Pca9685emu::write_byte_data (uint8_t reg, uint8_t value)
+{
+    if (!(_funcs & I2C_FUNC_SMBUS_WRITE_BYTE_DATA)) return -EOPNOTSUPP;
+
+    Chip *C = find (_addr);
+
+    _stats.ioctls++;
+    if (!C)
+    {
+        account (1, 1);
+        return -EIO;
+    }
+    account (1, 3);
+    write_regs (C, reg, &value, 1);
+    return 0;
+}
+
+
+int Pca9685emu::write_i2c_block_data (uint8_t reg, uint8_t length, const uint8_t *values)
+{
+    if (!(_funcs & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK)) return -EOPNOTSUPP;
+    if (length > I2C_SMBUS_I2C_BLOCK_MAX) length = I2C_SMBUS_I2C_BLOCK_MAX;
+
+    Chip *C = find (_addr);
+
+    _stats.ioctls++;
+    if (!C)
+    {
+        account (1, 1);
+        return -EIO;
+    }
+    account (1, 2 + length);
+    write_regs (C, reg, values, length);
+    return 0;
+}
+
+
+int Pca9685emu::transfer (struct i2c_msg *msgs, int nmsgs)
+{
+    // Messages may go to any chips on the bus. As on a real bus, the
+    // ones before a message that is not acknowledged have taken effect.
+
+    int i, n;
+
+    if (!(_funcs & I2C_FUNC_I2C)) return -EOPNOTSUPP;
+
+    _stats.ioctls++;
+    for (i = 0; i < nmsgs; i++)
+    {
+        if ((msgs [i].flags & I2C_M_RD) || (msgs [i].len < 1)) return -EINVAL;
+    }
+
+    for (i = n = 0; i < nmsgs; i++)
+    {
+        Chip *C = find (msgs [i].addr);
+
+        if (!C)
+        {
+            account (i + 1, n + 1);
+            return -EIO;
+        }
+        n += 1 + msgs [i].len;
+        write_regs (C, msgs [i].buf [0], (const uint8_t *)(msgs [i].buf + 1), msgs [i].len - 1);
+    }
+    account (nmsgs, n);
+    return nmsgs;
+}
+
+
+uint16_t Pca9685emu::pwm_off (int addr, int channel) const
+{
+    const Chip    *C = find (addr);
+    const uint8_t  r = PCA9685_LED0_OFF_L + channel * 4;
+
+    return C->regs [r] | ((C->regs [r + 1] & 0x1F) << 8);
+}
+
+
+void Pca9685emu::reset_stats (void)
+{
+    memset (&_stats, 0, sizeof (_stats));
+}
+
+
+void Pca9685emu::account (int nmsgs, int nbytes)
+{
+    // Every byte is 8 data bits plus ACK, every message starts with a
+    // (repeated) START and the transaction ends with a single STOP.
+
+    _stats.messages += nmsgs;
+    _stats.bytes += nbytes;
+    _stats.bits += nbytes * 9 + nmsgs + 1;
+}
+
+
+void Pca9685emu::write_regs (Chip *C, uint8_t reg, const uint8_t *values, int length)
+{
+    uint8_t *regs = C->regs;
+
+    while (length--)
+    {
+        regs [reg] = *values++;
+
+        // ALL_LED registers are applied to every channel
+        if (reg >= PCA9685_ALL_LED_ON_L && reg <= PCA9685_ALL_LED_OFF_H)
+        {
+            for (int i = 0; i < PCA9685_NUM_CHANNELS; i++)
+            {
+                regs [PCA9685_LED0_ON_L + i * 4 + reg - PCA9685_ALL_LED_ON_L] = regs [reg];
+            }
+        }
+
+        // without auto-increment every byte goes to the same register,
+        // with it the LED registers wrap back to MODE1 after LED15_OFF_H
+        if (regs [PCA9685_MODE1] & PCA9685_AI)
+        {
+            reg = (reg == PCA9685_LED0_OFF_H + (PCA9685_NUM_CHANNELS - 1) * 4) ? PCA9685_MODE1 : reg + 1;
+        }
+    }
+}
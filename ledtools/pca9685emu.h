@@ -0,0 +1,96 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2026 The mod-peakmeter authors
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __PCA9685EMU_H
+#define __PCA9685EMU_H
+
+
+#include "i2cbus.h"
+
+
+// Bus traffic seen by an emulated device.
+
+struct I2Cstats
+{
+    unsigned long    ioctls;    // syscalls a real i2c-dev bus would have needed
+    unsigned long    messages;  // START conditions, including repeated ones
+    unsigned long    bytes;     // bytes on the wire, including address bytes
+    unsigned long    bits;      // SCL clock cycles, including START/STOP and ACKs
+
+    // time the bus is occupied at the given SCL frequency, in seconds
+    double bus_time (int clock) const { return (double) bits / clock; }
+};
+
+
+// In-memory PCA9685 chips on one bus, usable in place of a real bus.
+// Every chip added has its own register file and answers at its own
+// address, any other address is not acknowledged. Implements
+// auto-increment and the ALL_LED registers closely enough to check what
+// the LED code leaves behind, and counts all traffic on the bus.
+
+class Pca9685emu : public I2Cbus
+{
+public:
+
+    enum { MAXCHIP = 16 };
+
+    Pca9685emu (unsigned long funcs = I2C_FUNC_I2C | I2C_FUNC_SMBUS_BYTE_DATA | I2C_FUNC_SMBUS_I2C_BLOCK);
+    virtual ~Pca9685emu (void);
+
+    // a chip fresh from power-on at 'addr', returns -1 if there is
+    // already one there or no room for more
+    int add_chip (int addr);
+
+    int set_address (int addr);
+    unsigned long functionality (void) { return _funcs; }
+
+    int read_byte_data (uint8_t reg);
+    int write_byte_data (uint8_t reg, uint8_t value);
+    int write_i2c_block_data (uint8_t reg, uint8_t length, const uint8_t *values);
+    int transfer (struct i2c_msg *msgs, int nmsgs);
+
+    // register contents of the chip at 'addr', which must exist
+    uint8_t reg (int addr, uint8_t reg) const { return find (addr)->regs [reg]; }
+    uint16_t pwm_off (int addr, int channel) const;
+
+    const I2Cstats& stats (void) const { return _stats; }
+    void reset_stats (void);
+
+private:
+
+    struct Chip
+    {
+        int      addr;
+        uint8_t  regs [256];
+    };
+
+    Chip *find (int addr) const;
+    void account (int nmsgs, int nbytes);
+    static void write_regs (Chip *C, uint8_t reg, const uint8_t *values, int length);
+
+    unsigned long    _funcs;
+    int              _nchip;
+    Chip             _chips [MAXCHIP];
+    I2Cstats         _stats;
+};
+
+
+#endif
@@ -1,5 +1,6 @@
+#include "ledtools/pca9685.h"
 
-void setPWMFreq(int bus, float freq)
+void setPWMFreq(I2Cbus* const bus, float freq)
 {
     printf("Set PWM frequency %f\n", freq);
 
@@ -13,33 +14,33 @@ void setPWMFreq(int bus, float freq)
     const int prescale = std::floor(prescaleval + 0.5f);
     printf("Final pre-scale: %d\n", prescale);
 
-    const int oldmode = i2c_smbus_read_byte_data(bus, PCA9685_MODE1);
+    const int oldmode = bus->read_byte_data(PCA9685_MODE1);
     /* */ int newmode = (oldmode & 0x7F) | PCA9685_SLEEP;
-    i2c_smbus_write_byte_data(bus, PCA9685_MODE1, newmode); // go to sleep
-    i2c_smbus_write_byte_data(bus, PCA9685_PRESCALE, prescale);
-    i2c_smbus_write_byte_data(bus, PCA9685_MODE1, oldmode);
+    bus->write_byte_data(PCA9685_MODE1, newmode); // go to sleep
+    bus->write_byte_data(PCA9685_PRESCALE, prescale);
+    bus->write_byte_data(PCA9685_MODE1, oldmode);
     usleep(5*1000);
-    i2c_smbus_write_byte_data(bus, PCA9685_MODE1, oldmode | PCA9685_RESTART);
+    bus->write_byte_data(PCA9685_MODE1, oldmode | PCA9685_RESTART);
 }
 
-int setPWM(int bus, uint8_t channel, uint16_t on, uint16_t off)
+int setPWM(I2Cbus* const bus, uint8_t channel, uint16_t on, uint16_t off)
 {
     printf("Set a single PWM channel %i %i %i\n", channel, on, off);
-    if (i2c_smbus_write_byte_data(bus, PCA9685_LED0_ON_L  + channel*4, on & 0xFF)  < 0 ||
-        i2c_smbus_write_byte_data(bus, PCA9685_LED0_ON_H  + channel*4, on >> 8)    < 0 ||
-        i2c_smbus_write_byte_data(bus, PCA9685_LED0_OFF_L + channel*4, off & 0xFF) < 0 ||
-        i2c_smbus_write_byte_data(bus, PCA9685_LED0_OFF_H + channel*4, off >> 8)   < 0)
+    if (bus->write_byte_data(PCA9685_LED0_ON_L  + channel*4, on & 0xFF)  < 0 ||
+        bus->write_byte_data(PCA9685_LED0_ON_H  + channel*4, on >> 8)    < 0 ||
+        bus->write_byte_data(PCA9685_LED0_OFF_L + channel*4, off & 0xFF) < 0 ||
+        bus->write_byte_data(PCA9685_LED0_OFF_H + channel*4, off >> 8)   < 0)
         return -1;
     return 0;
 }
 
-int setAllPWM(int bus, uint16_t on, uint16_t off)
+int setAllPWM(I2Cbus* const bus, uint16_t on, uint16_t off)
 {
     printf("Set all PWM channels %i %i\n", on, off);
-    if (i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_ON_L,  on & 0xFF)  < 0 ||
-        i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_ON_H,  on >> 8)    < 0 ||
-        i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_OFF_L, off & 0xFF) < 0 ||
-        i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_OFF_H, off >> 8)   < 0)
+    if (bus->write_byte_data(PCA9685_ALL_LED_ON_L,  on & 0xFF)  < 0 ||
+        bus->write_byte_data(PCA9685_ALL_LED_ON_H,  on >> 8)    < 0 ||
+        bus->write_byte_data(PCA9685_ALL_LED_OFF_L, off & 0xFF) < 0 ||
+        bus->write_byte_data(PCA9685_ALL_LED_OFF_H, off >> 8)   < 0)
         return -1;
     return 0;
 }
@@ -17,6 +17,7 @@
 //
 // ----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdio>
@@ -25,9 +26,11 @@
 #include <cstring>
 
 #include <fcntl.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <syscall.h>
 #include <linux/futex.h>
 
@@ -35,52 +38,32 @@
 #define SYS_futex SYS_futex_time64
 #endif
 
-extern "C" {
-#include "i2c-dev.h"
-}
-
+#include "jacktools/banddsp.h"
 #include "jacktools/jkmeter.h"
+#include "ledtools/ledcolortable.h"
+#include "ledtools/ledmapper.h"
+#include "ledtools/ledrate.h"
+#include "ledtools/ledwriter.h"
 
 // --------------------------------------------------------------------------------------------------------------------
 
-/* Register Addresses */
-#define PCA9685_MODE1         0x00
-#define PCA9685_MODE2         0x01
-#define PCA9685_LED0_ON_L     0x06
-#define PCA9685_LED0_ON_H     0x07
-#define PCA9685_LED0_OFF_L    0x08
-#define PCA9685_LED0_OFF_H    0x09
-#define PCA9685_ALL_LED_ON_L  0xFA
-#define PCA9685_ALL_LED_ON_H  0xFB
-#define PCA9685_ALL_LED_OFF_L 0xFC
-#define PCA9685_ALL_LED_OFF_H 0xFD
-#define PCA9685_PRESCALE      0xFE
-
-/* MODE1 Register */
-#define PCA9685_ALLCALL 0x01
-#define PCA9685_SLEEP   0x10
-#define PCA9685_RESTART 0x80
-
-/* MODE2 Register */
-#define PCA9685_OUTDRV  0x04
-#define PCA9685_INVRT   0x10
-
-/* Custom MOD */
-#define PCA9685_ADDR 0x41
-
-// Brightness values
-#define MIN_BRIGHTNESS_GREEN 120
-#define MIN_BRIGHTNESS_RED   120
-#define MAX_BRIGHTNESS_RED   1024
-
-#define MIN_BRIGHTNESS_GREEN_f 120.f
-#define MIN_BRIGHTNESS_RED_f   120.f
-
-// macro for mapping audio value to LED brightness
-#define MAP(x, Imin, Imax, Omin, Omax)      ((x - Imin) * (Omax -  Omin) / (Imax - Imin) + Omin)
-
-// weighing factor
-#define FILTER_WEIGHING_FACTOR 0.1f
+// LED frame intervals during transients/clipping and during silence, in ms
+#define LED_FRAME_FAST_MS 10
+#define LED_FRAME_IDLE_MS 250
+
+// loudness levels change on every block of this many ms, LEDs showing loudness are rendered at least this often
+#define LED_LOUDNESS_BLOCK_MS 100
+
+// meter inputs are connected to these, in order, unless MOD_PEAKMETER_SOURCES says otherwise
+#define DEFAULT_SOURCES "system:capture_1, system:capture_2, mod-monitor:out_1, mod-monitor:out_2"
+
+// band analysis worker: ring length, processing chunk in frames and time between runs in ms
+#define ANALYSIS_RING_FRAMES  16384
+#define ANALYSIS_CHUNK_FRAMES 1024
+#define ANALYSIS_INTERVAL_MS  20
+
+// time the clip indicator stays on after the last clipped sample or over, in ms, as long as the meter peak hold
+#define LED_CLIP_HOLD_MS 500
 
 // --------------------------------------------------------------------------------------------------------------------
 
@@ -89,58 +72,189 @@ typedef struct {
     int shm1, shm2;
     int padding;
     float peaks[4];
+    // momentary, short-term and integrated LUFS of the capture and monitor pairs,
+    // only written when the shared memory is big enough to hold them
+    float loudness[2][3];
+    // clipped samples and overs so far, and JACK frame time of the latest first over in a period,
+    // likewise only when there is room
+    uint32_t clips[4];
+    uint32_t overs[4];
+    uint32_t over_time[4];
+    // correlation and balance of the capture and monitor pairs, likewise
+    float correlation[2];
+    float balance[2];
+    // octave band levels of each input, 31.5 Hz to 16 kHz, likewise
+    float bands[4][Banddsp::NBAND];
 } Container;
 
 // --------------------------------------------------------------------------------------------------------------------
+// Global variables
 
-// Do not change these enums! They match how the hardware works.
-// Unless you're changing hardware, leave these alone.
-enum LED_ID {
-#ifndef _MOD_DEVICE_DWARF
-    // normal
-    kLedOut2,
-    kLedOut1,
-    kLedIn1,
-    kLedIn2
-#else
-    // inverted for dwarf
-    kLedOut1,
-    kLedOut2,
-    kLedIn2,
-    kLedIn1
-#endif
-};
+static volatile bool g_running   = false;
+static int           g_led_sem   = 0;
+static int           g_led_frame = 25; // normal time between LED frames, in ms
+static int           g_led_sleep = 0;  // silent time before the chips go to sleep, in ms, 0 for never
+static int           g_gpio_fd   = -1; // GPIO value, drives the output enable line
+static bool          g_true_peak = false; // meter oversampled peaks instead of sample peaks
+static pthread_t     g_thread    = -1;
+static Container*    g_container = nullptr;
+static size_t        g_container_size = 0;
+static int           g_led_loudness = -1; // LEDs show this loudness (0 momentary, 1 short-term, 2 integrated), -1 for peaks
+static Ledlayout     g_layout;
+static int           g_graph_sem = 0; // futex word, posted when JACK ports come or go
+static int           g_nsource = 0;
+static const char*   g_sources[Jkmeter::MAXINP]; // source port name or regex per meter input, may be empty
+static char          g_sources_spec[1024];
+static I2Cbus*       g_buses[Ledlayout::MAXBUS];
+static Ledwriter     g_writers[Ledlayout::MAXBUS];
 
-enum LED_Color {
-    kLedColorBlue,
-    kLedColorRed,
-    kLedColorGreen,
-    kLedColorOff
-};
+// --------------------------------------------------------------------------------------------------------------------
+// Helpers
 
-bool all_leds_off(const int bus)
+static void timespec_add_ms(struct timespec& ts, const int ms)
 {
-    return (i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_ON_L,  0) >= 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_ON_H,  0) >= 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_OFF_L, 0) >= 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_ALL_LED_OFF_H, 0) >= 0);
+    ts.tv_sec  += ms / 1000;
+    ts.tv_nsec += (ms % 1000) * 1000000;
+
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec  += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+}
+
+static long elapsed_ms(const struct timespec& from, const struct timespec& to)
+{
+    return (to.tv_sec - from.tv_sec) * 1000 + (to.tv_nsec - from.tv_nsec) / 1000000;
 }
 
-bool set_led_color(const int bus, LED_ID led_id, LED_Color led_color, uint16_t value)
+// wait for Jkmeter to post from the process callback, returns false on timeout, negative timeout waits forever
+static bool wait_for_post(int* const sem, const int timeout_ms)
 {
-    const uint8_t channel = (led_id*4+led_color)*4;
+    if (__atomic_load_n(sem, __ATOMIC_ACQUIRE) != 0)
+        return true;
 
-    return (i2c_smbus_write_byte_data(bus, PCA9685_LED0_OFF_L + channel, value & 0xFF) >= 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_LED0_OFF_H + channel, value >> 8)   >= 0);
+    struct timespec timeout = { 0, 0 };
+    timespec_add_ms(timeout, timeout_ms);
+    syscall(SYS_futex, sem, FUTEX_WAIT, 0, timeout_ms < 0 ? nullptr : &timeout, nullptr, 0);
+
+    return __atomic_load_n(sem, __ATOMIC_ACQUIRE) != 0;
 }
 
 // --------------------------------------------------------------------------------------------------------------------
-// Global variables
+// Source port connections
 
-static int           g_bus       = -1;
-static volatile bool g_running   = false;
-static pthread_t     g_thread    = -1;
-static Container*    g_container = nullptr;
+// splits a comma separated list of sources, one per meter input, in place
+static void parse_sources(const char* const spec)
+{
+    std::strncpy(g_sources_spec, spec, sizeof(g_sources_spec) - 1);
+    g_sources_spec[sizeof(g_sources_spec) - 1] = '\0';
+    g_nsource = 0;
+
+    for (char* s = g_sources_spec; s != nullptr && g_nsource < Jkmeter::MAXINP;)
+    {
+        char* const next = std::strchr(s, ',');
+        if (next != nullptr)
+            *next = '\0';
+
+        while (*s == ' ')
+            ++s;
+        for (char* e = s + std::strlen(s); e > s && e[-1] == ' ';)
+            *--e = '\0';
+
+        g_sources[g_nsource++] = s;
+        s = next != nullptr ? next + 1 : nullptr;
+    }
+}
+
+// Keeps every meter input connected to its source, sources that appear later or come back are connected
+// as soon as JACK registers their ports. JACK callbacks must not call the server, so this runs on its own thread.
+class Connector
+{
+public:
+    Connector(jack_client_t* const client, Jkmeter* const meter, const int nmeter)
+        : fClient(client),
+          fMeter(meter),
+          fCount(std::min(nmeter, g_nsource)),
+          fRunning(true)
+    {
+        __atomic_store_n(&g_graph_sem, 1, __ATOMIC_RELEASE);
+        fMeter->setup_portreg_post(&g_graph_sem);
+        fOk = pthread_create(&fThread, nullptr, run, this) == 0;
+    }
+
+    ~Connector()
+    {
+        fMeter->setup_portreg_post(nullptr);
+
+        if (fOk)
+        {
+            fRunning = false;
+            __atomic_store_n(&g_graph_sem, 1, __ATOMIC_RELEASE);
+            syscall(SYS_futex, &g_graph_sem, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+            pthread_join(fThread, nullptr);
+        }
+    }
+
+private:
+    static void* run(void* const arg)
+    {
+        Connector* const self = (Connector*)arg;
+
+        while (self->fRunning && g_running)
+        {
+            if (! wait_for_post(&g_graph_sem, -1))
+                continue;
+
+            // events during the pass post again, nothing is missed
+            __atomic_store_n(&g_graph_sem, 0, __ATOMIC_RELEASE);
+
+            if (self->fRunning && g_running)
+                self->connect_all();
+        }
+
+        return nullptr;
+    }
+
+    void connect_all()
+    {
+        for (int i = 0; i < fCount; ++i)
+        {
+            if (g_sources[i][0] == '\0')
+                continue;
+
+            // an exact port name first, anything else is a regular expression, the first match is used
+            if (jack_port_by_name(fClient, g_sources[i]) != nullptr)
+            {
+                connect(i, g_sources[i]);
+                continue;
+            }
+
+            if (const char** const ports = jack_get_ports(fClient, g_sources[i], JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput))
+            {
+                if (ports[0] != nullptr)
+                    connect(i, ports[0]);
+                jack_free(ports);
+            }
+        }
+    }
+
+    void connect(const int i, const char* const source)
+    {
+        if (jack_port_connected_to(fMeter->inp_port(i), source))
+            return;
+
+        if (fMeter->connect_inp_port(i, source) != 0)
+            printf("mod-peakmeter: failed to connect %s to input %d\n", source, i + 1);
+    }
+
+    jack_client_t* const fClient;
+    Jkmeter* const fMeter;
+    const int fCount;
+    volatile bool fRunning;
+    bool fOk;
+    pthread_t fThread;
+};
 
 // --------------------------------------------------------------------------------------------------------------------
 // Peak Meter thread
@@ -153,126 +267,239 @@ static void* peakmeter_run(void* arg)
     const bool using_container = g_container != nullptr;
     jack_client_t* const client = (jack_client_t*)arg;
 
-    float pks[4];
-    Jkmeter meter(client, 4, using_container ? g_container->peaks : pks);
+    const int nmeter = using_container ? 4 : g_layout.nmeter();
 
-    {
-        // connect monitor ports
-        char ourportname[255];
-        const char* const ourclientname = jack_get_client_name(client);
+    // loudness is measured per stereo pair, for the container only if it has room for it
+    int nprog = 0;
+    if (using_container)
+        nprog = g_container_size >= offsetof(Container, clips) ? 2 : 0;
+    else if (g_led_loudness >= 0)
+        nprog = nmeter % 2 == 0 ? nmeter / 2 : nmeter;
 
-        sprintf(ourportname, "%s:in_1", ourclientname);
-        jack_connect(client, "system:capture_1", ourportname);
+    float pks[Jkmeter::MAXINP];
+    float lus[Jkmeter::MAXINP][3];
+    // only peaks are shown, skip the RMS ballistics but keep the DC filter so levels stay the same
+    Jkmeter meter(client, nmeter, using_container ? g_container->peaks : pks, Kmeterdsp::DCFILT,
+                  nprog, using_container ? &g_container->loudness[0][0] : &lus[0][0]);
 
-        sprintf(ourportname, "%s:in_2", ourclientname);
-        jack_connect(client, "system:capture_2", ourportname);
+    unsigned int clips[Jkmeter::MAXINP], overs[Jkmeter::MAXINP], times[Jkmeter::MAXINP];
+    if (! using_container)
+        meter.setup_clips(clips, overs, times);
+    else if (g_container_size >= offsetof(Container, correlation))
+        meter.setup_clips(g_container->clips, g_container->overs, g_container->over_time);
 
-        if (jack_port_by_name(client, "mod-monitor:out_1") != nullptr)
-        {
-            sprintf(ourportname, "%s:in_3", ourclientname);
-            jack_connect(client, "mod-monitor:out_1", ourportname);
+    // phase problems show up in the container only, the LEDs have no way to show them
+    if (using_container && g_container_size >= offsetof(Container, bands))
+        meter.setup_corr(2, g_container->correlation, g_container->balance);
 
-            sprintf(ourportname, "%s:in_4", ourclientname);
-            jack_connect(client, "mod-monitor:out_2", ourportname);
-        }
+    if (g_true_peak)
+    {
+        for (int i = 0; i < nmeter; ++i)
+            meter.set_truepeak(i, true);
     }
 
+    // connect the sources now, and again whenever ports come and go until the meter goes away
+    Connector connector(client, &meter, nmeter);
+
     if (Container* const container = g_container)
     {
         meter.setup_post(&g_container->sem);
 
+        if (g_container_size < sizeof(Container))
+        {
+            while (meter.get_state() == Jkmeter::PROCESS && g_running)
+                usleep(100*1000);
+            return nullptr;
+        }
+
+        // this thread has nothing else to do, it becomes the worker for band analysis
+        Audioring* const ring = meter.create_ring(ANALYSIS_RING_FRAMES);
+        Banddsp band;
+        int rate = meter.jack_rate();
+        band.init(rate);
+
+        float buf[4][ANALYSIS_CHUNK_FRAMES];
+        float* const bufs[4] = { buf[0], buf[1], buf[2], buf[3] };
+
         while (meter.get_state() == Jkmeter::PROCESS && g_running)
-            usleep(100*1000);
+        {
+            usleep(ANALYSIS_INTERVAL_MS*1000);
+
+            if (meter.jack_rate() != rate)
+            {
+                rate = meter.jack_rate();
+                band.init(rate);
+            }
+
+            for (int n; (n = ring->read(bufs, ANALYSIS_CHUNK_FRAMES)) > 0;)
+                band.process(bufs, 4, n);
+
+            for (int i = 0; i < 4; ++i)
+                for (int b = 0; b < Banddsp::NBAND; ++b)
+                    container->bands[i][b] = band.read(i, b);
+        }
         return nullptr;
     }
 
-    if (g_bus == -1)
+    if (g_layout.nbus() == 0)
         return nullptr;
 
-    LED_ID colorIdMap[4] = {
-        kLedIn1,
-        kLedIn2,
-        kLedOut1,
-        kLedOut2,
-    };
+    Ledframe frame;
+    Ledmapper mapper;
+    Ledrate rate;
+    bool animating = true;
+    bool sleeping = false;
+    bool idle = false;
+    int interval = g_led_frame;
+    bool clipping[Jkmeter::MAXINP];
+    bool over[Jkmeter::MAXINP];
+    unsigned int lastclips[Jkmeter::MAXINP];
+    int cliphold_ms[Jkmeter::MAXINP];
+    float pkmax[Jkmeter::MAXINP];
+
+    mapper.setup(&g_layout);
+
+    // never ask for frames faster than the slowest bus can write them
+    int floor_ms = 0;
+    for (int b=0; b<g_layout.nbus(); ++b)
+        floor_ms = std::max(floor_ms, g_writers[b].min_interval());
+
+    rate.setup(std::min(LED_FRAME_FAST_MS, g_led_frame), g_led_frame, std::max(LED_FRAME_IDLE_MS, g_led_frame), floor_ms);
+
+    struct timespec now, last, next, idle_since;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    next = idle_since = last;
+
+    // only woken up when some level moved enough to change the LEDs, levels are fetched here as one frame
+    meter.setup_post(&g_led_sem, LED_LEVEL_STEP, false);
+
+    // without a reader of its own the LEDs still work, only short peaks may be missed
+    const int reader = meter.add_reader();
+    if (reader < 0)
+        printf("mod-peakmeter: no reader left for peak maxima\n");
+
+    std::memset(pkmax, 0, sizeof(pkmax));
+    if (reader >= 0)
+        meter.get_levels(reader, pkmax);
+    else
+        meter.get_levels();
+    for (int i = 0; i < nmeter; ++i)
+    {
+        clipping[i] = false;
+        lastclips[i] = clips[i];
+        cliphold_ms[i] = 0;
+    }
+
+    while (meter.get_state() == Jkmeter::PROCESS && g_running)
+    {
+        // never render faster than the current frame interval, except when idle, where the thread blocks on the
+        // post below anyway and the first transient after silence has to show right away
+        if (animating || ! idle)
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
 
-    float value;
-    uint8_t clip, clipping[4] = { 0, 0, 0, 0 };
-    uint16_t cval;
+        // with constant input there is nothing to do once smoothing and clip blink have settled,
+        // until some level moves, except waking up once to go to sleep in time when silent,
+        // loudness keeps changing with constant peaks though, so it is shown again on every block
+        int timeout_ms = -1;
 
-    uint16_t ledsCache[4][3] = {
-        {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}
-    };
+        clock_gettime(CLOCK_MONOTONIC, &now);
 
-    float filtered_value[4] = {
-        0.0f, 0.0f, 0.0f, 0.0f
-    };
+        if (! animating && idle && ! sleeping && g_led_sleep > 0)
+            timeout_ms = std::max(1L, g_led_sleep - elapsed_ms(idle_since, now));
 
-    #define set_led_color_cache(col, val)                  \
-        if (ledsCache[i][col] != val) {                    \
-            ledsCache[i][col] = val;                       \
-            set_led_color(g_bus, colorIdMap[i], col, val); \
+        if (nprog > 0)
+        {
+            const int block_ms = int(std::max(1L, LED_LOUDNESS_BLOCK_MS - elapsed_ms(last, now)));
+            timeout_ms = timeout_ms < 0 ? block_ms : std::min(timeout_ms, block_ms);
         }
 
-    while (meter.get_levels() == Jkmeter::PROCESS && g_running)
-    {
-        for (int i=0; i<4; ++i)
+        const bool posted = animating || wait_for_post(&g_led_sem, timeout_ms) || nprog > 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (posted)
         {
-            value = pks[i];
+            __atomic_store_n(&g_led_sem, 0, __ATOMIC_RELEASE);
 
-            if (value > 0.988f) // clipping
-            {
-                clip = ++clipping[i];
+            const int state = reader >= 0 ? meter.get_levels(reader, pkmax) : meter.get_levels();
 
-                if (clip < 5)
-                {
-                    set_led_color_cache(kLedColorRed, MAX_BRIGHTNESS_RED);
-                    set_led_color_cache(kLedColorGreen, 0);
-                }
-                else
-                {
-                    if (clip > 8)
-                        clipping[i] = 0;
+            if (state != Jkmeter::PROCESS || ! g_running)
+                break;
 
-                    set_led_color_cache(kLedColorRed, MIN_BRIGHTNESS_RED);
-                    set_led_color_cache(kLedColorGreen, 0);
-                }
+            // a peak near full scale counts as clipping too, this catches true-peak overs between samples that
+            // never clip themselves, and is taken before loudness replaces the peaks
+            for (int i = 0; i < nmeter; ++i)
+                over[i] = std::max(pks[i], pkmax[i]) > LED_LEVEL_CLIP;
+
+            // show loudness like a peak of the same level in dBFS,
+            // peaks are shown at least once even if they were gone before this frame
+            if (nprog > 0)
+            {
+                for (int i = 0; i < nmeter; ++i)
+                    pks[i] = std::pow(10.0f, 0.05f * lus[i * nprog / nmeter][g_led_loudness]);
             }
-            else // no clipping
+            else
             {
-                // was clipping before
-                if (clipping[i] > 0)
-                    clipping[i] = 0;
+                for (int i = 0; i < nmeter; ++i)
+                    pks[i] = std::max(pks[i], pkmax[i]);
+            }
 
-                value = FILTER_WEIGHING_FACTOR * value + (1.0f - FILTER_WEIGHING_FACTOR) * filtered_value[i];
+            // ballistics follow the real time between frames, whatever the rate or scheduling delays
+            const float dt = float(now.tv_sec - last.tv_sec) + 1e-9f * float(now.tv_nsec - last.tv_nsec);
+            last = now;
 
-                if (value < 0.009f) // x < -40dB, off
-                {
-                    set_led_color_cache(kLedColorRed, 0);
-                    set_led_color_cache(kLedColorGreen, 0);
-                }
-                else if (value < 0.5f) //x < -6dB, green
-                {
-                    cval = uint16_t(MAP(value, 0.0f, 0.5f, 10.f, MIN_BRIGHTNESS_GREEN_f));
-                    set_led_color_cache(kLedColorRed, 0);
-                    set_led_color_cache(kLedColorGreen, cval);
-                }
-                else if (value < 0.9f) //x < -1dB, yellow
+            // the clip indicator follows the clipped samples counted by the meter and the overs
+            for (int i = 0; i < nmeter; ++i)
+            {
+                if (clips[i] != lastclips[i] || over[i])
                 {
-                    cval = uint16_t(MAP(value, 0.5f, 0.9f, 10.f, MIN_BRIGHTNESS_RED_f));
-                    set_led_color_cache(kLedColorRed, cval);
-                    set_led_color_cache(kLedColorGreen, MIN_BRIGHTNESS_GREEN);
+                    lastclips[i] = clips[i];
+                    cliphold_ms[i] = LED_CLIP_HOLD_MS;
                 }
-                else // all red
+                else if (cliphold_ms[i] > 0)
                 {
-                    set_led_color_cache(kLedColorRed, MIN_BRIGHTNESS_RED);
-                    set_led_color_cache(kLedColorGreen, 0);
+                    cliphold_ms[i] -= int(1000.0f * dt + 0.5f);
                 }
 
-                filtered_value[i] = value;
+                clipping[i] = cliphold_ms[i] > 0;
             }
+
+            animating = mapper.process(pks, &frame, dt, clipping);
+            interval = rate.update(pks, nmeter, &frame);
+
+            if (rate.idle() && ! idle)
+                idle_since = now;
+            idle = rate.idle();
+        }
+
+        // put the chips to sleep once silent for long enough, also when no frame was due since the signal went,
+        // wake them on the first frame with signal
+        const long idle_ms = idle ? elapsed_ms(idle_since, now) : 0;
+
+        if (g_led_sleep > 0 && sleeping != (idle_ms >= g_led_sleep))
+        {
+            sleeping = ! sleeping;
+
+            // output enable is active low
+            if (g_gpio_fd >= 0 && pwrite(g_gpio_fd, sleeping ? "1\n" : "0\n", 2, 0) != 2)
+                printf("mod-peakmeter: gpio value change failed\n");
+        }
+        else if (! posted)
+        {
+            continue;
+        }
+
+        frame.sleep = sleeping;
+
+        for (int b=0; b<g_layout.nbus(); ++b)
+        {
+            Ledmailbox* const mailbox = g_writers[b].mailbox();
+            std::memcpy(mailbox->write_frame(), &frame, sizeof(Ledframe));
+            mailbox->publish();
         }
-        usleep(25*1000);
+
+        next = now;
+        timespec_add_ms(next, interval);
     }
 
     return nullptr;
@@ -294,7 +521,30 @@ static int jack_initialize_container(jack_client_t* client)
         return 1;
     }
 
-    Container* const container = (Container*)mmap(NULL, sizeof(Container),
+    // older containers end after an earlier field, map only what is there
+    const size_t sizes[] = {
+        sizeof(Container),
+        offsetof(Container, bands),
+        offsetof(Container, correlation),
+        offsetof(Container, clips),
+    };
+
+    struct stat st;
+    size_t size = offsetof(Container, loudness);
+
+    if (fstat(fd, &st) == 0)
+    {
+        for (size_t s : sizes)
+        {
+            if (size_t(st.st_size) >= s)
+            {
+                size = s;
+                break;
+            }
+        }
+    }
+
+    Container* const container = (Container*)mmap(NULL, size,
                                                   PROT_READ|PROT_WRITE, MAP_SHARED|MAP_LOCKED, fd, 0);
 
     if (container == NULL || container == MAP_FAILED)
@@ -306,6 +556,7 @@ static int jack_initialize_container(jack_client_t* client)
 
     container->shm2 = fd;
     g_container = container;
+    g_container_size = size;
 
     // ----------------------------------------------------------------------------------------------------------------
     // Start peakmeter thread
@@ -319,157 +570,219 @@ static int jack_initialize_container(jack_client_t* client)
 // --------------------------------------------------------------------------------------------------------------------
 // peakmeter using MOD LEDs
 
-static int jack_initialize_leds(jack_client_t* client, const char* load_init)
+// writes `value` to a sysfs attribute unless it already holds it
+static bool write_sysfs(const char* const path, const char* const value)
 {
-    // ----------------------------------------------------------------------------------------------------------------
-    // Check if using inverted mode
+    const int fd = open(path, O_RDWR|O_CLOEXEC);
 
-    bool inverted = (load_init != nullptr && load_init[0] != '\0' &&
-                     (std::strcmp(load_init, "1") == 0 || std::strcmp(load_init, "true") == 0));
+    if (fd < 0)
+        return false;
 
-    // ----------------------------------------------------------------------------------------------------------------
-    // Setup environment
+    const size_t len = std::strlen(value);
+    char cur[32];
+    const ssize_t r = read(fd, cur, sizeof(cur));
+    bool ok = true;
 
-    const char* const bus_number_env = std::getenv("MOD_PEAKMETER_BUS_NUMBER");
+    if (r != (ssize_t)len || std::memcmp(cur, value, len) != 0)
+        ok = pwrite(fd, value, len, 0) == (ssize_t)len;
+
+    close(fd);
+    return ok;
+}
 
-    if (bus_number_env == nullptr || bus_number_env[0] == '\0')
+static bool init_chip(I2Cbus* const bus, const uint8_t addr, const bool inverted)
+{
+    bool warm;
+
+    if (! init_led_chip(bus, addr, inverted, &warm))
     {
-        printf("MOD_PEAKMETER_BUS_NUMBER env var missing\n");
-        return 1;
+        printf("mod-peakmeter: setup of chip 0x%02x failed\n", addr);
+        return false;
     }
 
-    const char* const gpio_path_env = std::getenv("MOD_PEAKMETER_GPIO_PATH");
+    if (warm)
+        printf("mod-peakmeter: chip 0x%02x already configured, only cleared LEDs\n", addr);
 
-    if (gpio_path_env == nullptr || gpio_path_env[0] == '\0')
+    return true;
+}
+
+static void close_leds()
+{
+    for (int b=0; b<Ledlayout::MAXBUS; ++b)
     {
-        printf("MOD_PEAKMETER_GPIO_PATH env var missing\n");
-        return 1;
+        g_writers[b].stop();
+
+        if (b < g_layout.nbus() && g_writers[b].errors() != 0)
+            printf("mod-peakmeter: bus %d had %lu failed transactions\n", g_layout.bus(b).number, g_writers[b].errors());
+
+        delete g_buses[b];
+        g_buses[b] = nullptr;
     }
+}
 
-    const int bus_number = std::atoi(bus_number_env);
-    const size_t gpio_path_len = std::strlen(gpio_path_env);
+// undoes a partial jack_initialize_leds, for its error returns
+static int abort_leds()
+{
+    close_leds();
 
-    if (gpio_path_len > 1000)
+    if (g_gpio_fd >= 0)
     {
-        printf("MOD_PEAKMETER_GPIO_PATH env var value is too big\n");
-        return 1;
+        close(g_gpio_fd);
+        g_gpio_fd = -1;
     }
 
+    g_layout = Ledlayout();
+    return 1;
+}
+
+static int jack_initialize_leds(jack_client_t* client, const char* load_init)
+{
     // ----------------------------------------------------------------------------------------------------------------
-    // Configure GPIO
+    // Check if using inverted mode
 
-    FILE* fd;
-    char gpio_path[1024];
-    std::strcpy(gpio_path, gpio_path_env);
+    bool inverted = (load_init != nullptr && load_init[0] != '\0' &&
+                     (std::strcmp(load_init, "1") == 0 || std::strcmp(load_init, "true") == 0));
 
-    std::strcpy(&gpio_path[gpio_path_len], "/direction");
-    fd = fopen(gpio_path, "w");
-    if (fd != NULL)
-    {
-        fprintf(fd, "out\n");
-        fclose(fd);
-    }
-    else
-    {
-        printf("mod-peakmeter: gpio direction setup failed, path: %s\n", gpio_path);
-    }
+    // ----------------------------------------------------------------------------------------------------------------
+    // Setup environment
 
-    std::strcpy(&gpio_path[gpio_path_len], "/value");
-    fd = fopen(gpio_path, "w");
-    if (fd != NULL)
+    const char* const layout_env = std::getenv("MOD_PEAKMETER_LAYOUT");
+
+    if (layout_env != nullptr && layout_env[0] != '\0')
     {
-        fprintf(fd, "0\n");
-        fclose(fd);
+        if (g_layout.parse(layout_env) != 0)
+        {
+            printf("MOD_PEAKMETER_LAYOUT env var value is invalid\n");
+            return abort_leds();
+        }
     }
     else
     {
-        printf("mod-peakmeter: gpio value setup failed, path: %s\n", gpio_path);
-    }
+        const char* const bus_number_env = std::getenv("MOD_PEAKMETER_BUS_NUMBER");
 
-    // ----------------------------------------------------------------------------------------------------------------
-    // Open i2c bus
+        if (bus_number_env == nullptr || bus_number_env[0] == '\0')
+        {
+            printf("MOD_PEAKMETER_BUS_NUMBER env var missing\n");
+            return abort_leds();
+        }
 
-    char i2c_dev_path[16];
-    sprintf(i2c_dev_path, "/dev/i2c-%d", bus_number);
+        g_layout.set_default(std::atoi(bus_number_env));
+    }
 
-    const int bus = open(i2c_dev_path, O_RDWR);
+    const char* const gpio_path_env = std::getenv("MOD_PEAKMETER_GPIO_PATH");
 
-    if (bus < 0)
+    if (gpio_path_env == nullptr || gpio_path_env[0] == '\0')
     {
-        printf("open failed\n");
-        return 1;
+        printf("MOD_PEAKMETER_GPIO_PATH env var missing\n");
+        return abort_leds();
     }
 
-    if (ioctl(bus, I2C_SLAVE, PCA9685_ADDR) < 0)
+    if (const char* const frame_env = std::getenv("MOD_PEAKMETER_FRAME_INTERVAL"))
     {
-        printf("slave addr failed\n");
-        return 1;
+        const int frame = std::atoi(frame_env);
+
+        if (frame > 0 && frame <= 1000)
+            g_led_frame = frame;
+        else
+            printf("MOD_PEAKMETER_FRAME_INTERVAL env var value is invalid, using %d ms\n", g_led_frame);
     }
 
-    // ----------------------------------------------------------------------------------------------------------------
-    // Reseting PCA9685 MODE1 (without SLEEP) and MODE2
+    int bus_budget = 0;
 
-    if (! all_leds_off(bus))
+    if (const char* const budget_env = std::getenv("MOD_PEAKMETER_BUS_BUDGET"))
     {
-        printf("write byte data1 failed\n");
-        return 1;
-    }
+        const int budget = std::atoi(budget_env);
 
-    const uint8_t flags = inverted ? (PCA9685_INVRT|PCA9685_OUTDRV) : PCA9685_OUTDRV;
+        if (budget >= 0 && budget <= 1000000)
+            bus_budget = budget;
+        else
+            printf("MOD_PEAKMETER_BUS_BUDGET env var value is invalid, not limiting bus time\n");
+    }
 
-    if (i2c_smbus_write_byte_data(bus, PCA9685_MODE2, flags) < 0)
+    if (const char* const sleep_env = std::getenv("MOD_PEAKMETER_SLEEP_AFTER"))
     {
-        printf("write byte data2 failed\n");
-        return 1;
+        const int sleep = std::atoi(sleep_env);
+
+        if (sleep >= 0 && sleep <= 86400)
+            g_led_sleep = sleep * 1000;
+        else
+            printf("MOD_PEAKMETER_SLEEP_AFTER env var value is invalid, LEDs will not sleep\n");
     }
 
-    if (i2c_smbus_write_byte_data(bus, PCA9685_MODE1, PCA9685_ALLCALL) < 0)
+    if (const char* const loudness_env = std::getenv("MOD_PEAKMETER_LOUDNESS"))
     {
-        printf("write byte data3 failed\n");
-        return 1;
+        if (std::strcmp(loudness_env, "momentary") == 0)
+            g_led_loudness = 0;
+        else if (std::strcmp(loudness_env, "short-term") == 0)
+            g_led_loudness = 1;
+        else if (std::strcmp(loudness_env, "integrated") == 0)
+            g_led_loudness = 2;
+        else if (loudness_env[0] != '\0')
+            printf("MOD_PEAKMETER_LOUDNESS env var value is invalid, LEDs will show peaks\n");
     }
 
-    // wait for oscillator
-    usleep(5*1000);
+    const size_t gpio_path_len = std::strlen(gpio_path_env);
+
+    if (gpio_path_len > 1000)
+    {
+        printf("MOD_PEAKMETER_GPIO_PATH env var value is too big\n");
+        return abort_leds();
+    }
 
     // ----------------------------------------------------------------------------------------------------------------
-    // wake up (reset sleep)
+    // Configure GPIO
 
-    int mode1 = i2c_smbus_read_byte_data(bus, PCA9685_MODE1);
-    mode1 = mode1 & ~PCA9685_SLEEP;
+    char gpio_path[1024];
+    std::strcpy(gpio_path, gpio_path_env);
 
-    if (i2c_smbus_write_byte_data(bus, PCA9685_MODE1, mode1) < 0)
-    {
-        printf("write byte data4 failed\n");
-        return 1;
-    }
+    std::strcpy(&gpio_path[gpio_path_len], "/direction");
+    if (! write_sysfs(gpio_path, "out\n"))
+        printf("mod-peakmeter: gpio direction setup failed, path: %s\n", gpio_path);
 
-    // wait for oscillator
-    usleep(5*1000);
+    std::strcpy(&gpio_path[gpio_path_len], "/value");
+    if (! write_sysfs(gpio_path, "0\n"))
+        printf("mod-peakmeter: gpio value setup failed, path: %s\n", gpio_path);
 
-    // ----------------------------------------------------------------------------------------------------------------
-    // Reset everything
+    // kept open for turning the outputs off while sleeping
+    if (g_led_sleep > 0)
+        g_gpio_fd = open(gpio_path, O_WRONLY|O_CLOEXEC);
 
-    /* By resetting all values we will only need to change the 2 off bits for setting led color.
-     * This makes led color change faster, and also uses less cpu. */
+    // ----------------------------------------------------------------------------------------------------------------
+    // Open i2c buses and setup every chip on them
 
-    for (int i=0; i<16; ++i)
+    for (int b=0; b<g_layout.nbus(); ++b)
     {
-        if (i2c_smbus_write_byte_data(bus, PCA9685_LED0_ON_L  + i*4, 0) < 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_LED0_ON_H  + i*4, 0) < 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_LED0_OFF_L + i*4, 0) < 0 &&
-            i2c_smbus_write_byte_data(bus, PCA9685_LED0_OFF_H + i*4, 0) < 0)
+        const Ledlayout::Bus& lbus(g_layout.bus(b));
+
+        I2Cdevbus* const bus = new I2Cdevbus();
+        g_buses[b] = bus;
+
+        if (bus->open_bus(lbus.number) < 0)
+        {
+            printf("open failed\n");
+            return abort_leds();
+        }
+
+        for (int k=0; k<lbus.nchip; ++k)
         {
-            printf("write byte data5 failed\n");
-            return 1;
+            if (! init_chip(bus, g_layout.chip(lbus.chips[k]).addr, inverted))
+            {
+                return abort_leds();
+            }
         }
     }
 
     // ----------------------------------------------------------------------------------------------------------------
-    // Start peakmeter thread
+    // Start one writer thread per bus, then the peakmeter thread
+
+    for (int b=0; b<g_layout.nbus(); ++b)
+    {
+        g_writers[b].set_budget(bus_budget, g_led_frame);
+        g_writers[b].start(g_buses[b], &g_layout, b, inverted);
+    }
 
-    g_bus = bus;
     g_running = true;
+    g_led_sem = 0;
     pthread_create(&g_thread, NULL, peakmeter_run, client);
 
     return 0;
@@ -483,6 +796,12 @@ int jack_initialize(jack_client_t* client, const char* load_init);
 
 int jack_initialize(jack_client_t* client, const char* load_init)
 {
+    const char* const sources_env = std::getenv("MOD_PEAKMETER_SOURCES");
+    parse_sources(sources_env != nullptr && sources_env[0] != '\0' ? sources_env : DEFAULT_SOURCES);
+
+    if (const char* const true_peak_env = std::getenv("MOD_PEAKMETER_TRUE_PEAK"))
+        g_true_peak = (std::strcmp(true_peak_env, "1") == 0 || std::strcmp(true_peak_env, "true") == 0);
+
     if (load_init != nullptr && std::strcmp(load_init, "container") == 0)
         return jack_initialize_container(client);
 
@@ -495,21 +814,36 @@ void jack_finish(void *arg);
 void jack_finish(void *arg)
 {
     g_running = false;
+
+    // wake up LED thread if waiting for levels
+    __atomic_store_n(&g_led_sem, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &g_led_sem, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+
+    // and the connector
+    __atomic_store_n(&g_graph_sem, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &g_graph_sem, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+
     pthread_join(g_thread, nullptr);
 
-    if (g_bus != -1)
-        close(g_bus);
+    close_leds();
+
+    if (g_gpio_fd >= 0)
+    {
+        close(g_gpio_fd);
+        g_gpio_fd = -1;
+    }
 
     if (g_container != nullptr)
     {
         const int fd = g_container->shm2;
-        munmap(g_container, sizeof(Container));
+        munmap(g_container, g_container_size);
         close(fd);
     }
 
-    g_bus = -1;
     g_thread = -1;
     g_container = nullptr;
+    g_container_size = 0;
+    g_layout = Ledlayout();
 
     return;
 
@@ -519,8 +853,21 @@ void jack_finish(void *arg)
 
 // --------------------------------------------------------------------------------------------------------------------
 
+#include "jacktools/audioring.cc"
+#include "jacktools/banddsp.cc"
+#include "jacktools/corrdsp.cc"
 #include "jacktools/jclient.cc"
 #include "jacktools/jkmeter.cc"
 #include "jacktools/kmeterdsp.cc"
+#include "jacktools/lufsdsp.cc"
+#include "jacktools/peaksnap.cc"
+#include "ledtools/i2cbus.cc"
+#include "ledtools/ledframe.cc"
+#include "ledtools/ledlayout.cc"
+#include "ledtools/ledmapper.cc"
+#include "ledtools/ledrate.cc"
+#include "ledtools/ledscheduler.cc"
+#include "ledtools/ledwriter.cc"
+#include "ledtools/pca9685.cc"
 
 // --------------------------------------------------------------------------------------------------------------------